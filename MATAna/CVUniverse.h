@@ -10,7 +10,7 @@
 // will mean overriding the function that calculates the quantity that is being
 // shifted (muon energy, or hadronic energy or whatever).
 //
-// For examples of each of those two cases, see ./LateralSystematics.h and
+// For examples of each of those two cases, see ./Systematics.h and
 // PlotUtils/GenieSystematics.h. For an example of how to put the whole thing
 // together and actually *use* the classes, see the runEventLoop.C macro in
 // this directory. `root -l -b load.C+ runEventLoop.C+`
@@ -18,16 +18,119 @@
 #ifndef CVUNIVERSE_H
 #define CVUNIVERSE_H
 
+#include <bitset>
+#include <cstdlib>
+#include <initializer_list>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
 
 #include "PlotUtils/ChainWrapper.h"
 #include "PlotUtils/BaseUniverse.h"
+#include "TLeaf.h"
+#include "TTree.h"
+
+// ========================================================================
+// Per-entry cache of the branches read by the CVUniverse getters, shared by
+// all universes on one chain. Each column's leaf is looked up by name once per
+// tree of the chain (again only when the chain moves to its next file), and
+// entries are read through that TLeaf: only the column's own branch is
+// unpacked, and at most once per entry however many universes ask for it.
+// ========================================================================
+class ColumnCache {
+ public:
+  enum Column {
+    kNTrackHits,
+    kDemMom,
+    kSignalWindowTime,
+    kMaxRadius,
+    kTrackQual,
+    kNHits,
+    kNColumns
+  };
+  typedef std::bitset<kNColumns> ColumnSet;
+
+  static ColumnSet Columns(std::initializer_list<Column> columns) {
+    ColumnSet set;
+    for (Column column : columns) set.set(column);
+    return set;
+  }
+
+  explicit ColumnCache(PlotUtils::ChainWrapper* chw) : m_chw(chw) {}
+
+  // One cache per chain; only called when a universe is constructed.
+  static std::shared_ptr<ColumnCache> ForChain(PlotUtils::ChainWrapper* chw) {
+    static std::mutex mutex;
+    static std::map<PlotUtils::ChainWrapper*, std::weak_ptr<ColumnCache> >
+        caches;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_ptr<ColumnCache> cache = caches[chw].lock();
+    if (!cache) {
+      cache = std::make_shared<ColumnCache>(chw);
+      caches[chw] = cache;
+    }
+    return cache;
+  }
+
+  static const char* BranchName(Column column) {
+    static const char* names[kNColumns] = {
+        "demmc.nhits", "demfit_mom0",       "demfit_t0",
+        "demlh_maxr0", "demtrkqual_result", "dem.nactive"};
+    return names[column];
+  }
+
+  double Get(Column column, Long64_t entry) {
+    if (entry != m_entry) Load(entry);
+    if (!m_loaded[column]) {
+      TLeaf* leaf = Leaf(column);
+      leaf->GetBranch()->GetEntry(m_tree_entry);
+      m_values[column] = leaf->GetValue(0);
+      m_loaded.set(column);
+    }
+    return m_values[column];
+  }
+
+ private:
+  // Moves to entry; the leaves are re-resolved when it is in another tree
+  void Load(Long64_t entry) {
+    m_entry = entry;
+    m_loaded.reset();
+    TTree* chain = m_chw->GetTree();
+    m_tree_entry = chain->LoadTree(entry);
+    if (chain->GetTreeNumber() != m_tree_number) {
+      m_tree_number = chain->GetTreeNumber();
+      for (TLeaf*& leaf : m_leaves) leaf = nullptr;
+    }
+  }
+
+  TLeaf* Leaf(Column column) {
+    if (!m_leaves[column]) {
+      m_leaves[column] = m_chw->GetTree()->GetLeaf(BranchName(column));
+      if (!m_leaves[column]) {
+        std::cerr << "ColumnCache: branch " << BranchName(column)
+                  << " not in tree\n";
+        exit(1);
+      }
+    }
+    return m_leaves[column];
+  }
+
+  PlotUtils::ChainWrapper* m_chw;
+  Long64_t m_entry = -1;
+  Long64_t m_tree_entry = -1;  // entry in the chain's current tree
+  int m_tree_number = -1;
+  TLeaf* m_leaves[kNColumns] = {nullptr};
+  std::bitset<kNColumns> m_loaded;
+  double m_values[kNColumns];
+};
 
 class CVUniverse : public PlotUtils::BaseUniverse {
  public:
   // Constructor
   CVUniverse(PlotUtils::ChainWrapper* chw, double nsigma = 0)
-      : PlotUtils::BaseUniverse(chw, nsigma) {}
+      : PlotUtils::BaseUniverse(chw, nsigma),
+        m_columns(ColumnCache::ForChain(chw)) {}
 
   // Destructor
   virtual ~CVUniverse() {}
@@ -45,6 +148,15 @@ class CVUniverse : public PlotUtils::BaseUniverse {
     return 1;
   }
 
+  // Columns whose getters this universe overrides. The event loop reuses the
+  // CV cut decision when no cut reads them and the CV variables when there
+  // are none (see UniverseScheduler.h). The default, every column, is always
+  // correct but re-cuts the universe on every entry: a new universe should
+  // return exactly the columns it shifts, or {} if it only changes GetWeight().
+  virtual ColumnCache::ColumnSet ShiftedColumns() const {
+    return ColumnCache::ColumnSet().set();
+  }
+
   // ========================================================================
   // Get Variable Functions
   // Write a virtual "Get" function for _any_ variable (coming directly from a
@@ -54,18 +166,14 @@ class CVUniverse : public PlotUtils::BaseUniverse {
   // We override some or all of these function in different systematic
   // universe classes located in LateralSystematics.h.
   // ========================================================================
-  virtual int get_n_track_hits() const { return GetInt("demmc.nhits"); }
-  virtual double get_det0() const { return GetDouble("de.t0"); } // OLD
-  virtual double get_deenttd() const { return GetDouble("deent.td"); }
-  virtual double get_deentd0() const { return GetDouble("deent.d0"); }
-  virtual double get_detrkqual() const { return GetDouble("dequal.TrkQual"); }
-
-  // New TrkAna cut vars
-  virtual double get_dem_mom() const { return GetDouble("demfit_mom0"); }
-  virtual double get_signal_window_time() const { return GetDouble("demfit_t0"); }
-  virtual double get_max_radius() const { return GetDouble("demlh_maxr0"); }
-  virtual double get_track_qual() const { return GetDouble("demtrkqual_result"); }
-  virtual double get_n_hits() const { return GetInt("dem.nactive"); }
+  virtual int get_n_track_hits() const { return int(GetColumn(ColumnCache::kNTrackHits)); }
+
+  // TrkAna cut vars
+  virtual double get_dem_mom() const { return GetColumn(ColumnCache::kDemMom); }
+  virtual double get_signal_window_time() const { return GetColumn(ColumnCache::kSignalWindowTime); }
+  virtual double get_max_radius() const { return GetColumn(ColumnCache::kMaxRadius); }
+  virtual double get_track_qual() const { return GetColumn(ColumnCache::kTrackQual); }
+  virtual double get_n_hits() const { return GetColumn(ColumnCache::kNHits); }
 
     //branches['ntrk'] = [len(p) for p in branches['demfit']['sid']]
     //branches = apply_cuts(branches, {'ntrk' : 1})
@@ -93,9 +201,14 @@ class CVUniverse : public PlotUtils::BaseUniverse {
     branches['mcproc1'] = branches['demmcsim','startCode'][:,0,0]
   */
 
+ protected:
+  // Value of a cached branch at this universe's entry
+  double GetColumn(ColumnCache::Column column) const {
+    return m_columns->Get(column, m_entry);
+  }
 
-
-
+ private:
+  std::shared_ptr<ColumnCache> m_columns;
 };
 
 #endif
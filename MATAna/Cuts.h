@@ -0,0 +1,165 @@
+// ========================================================================
+// Selections as compile-time lists of cut objects.
+//
+// A cut is a struct with a Name(), the ColumnCache columns it reads and a
+// static Pass() templated on the universe type. Selection<Cuts...>::Pass()
+// expands to a short-circuit && over the cuts in the order they are listed,
+// so the event loop has no switch and no dead cuts.
+//
+// List the cuts with the most rejecting first. The order is fixed at compile
+// time and is not changed by the profile: PrintRejectionProfile() measures
+// how often each cut rejects on its own and prints the Selection<...> typedef
+// with the cuts in that order, which has to be pasted over the typedef below
+// (runEventLoop(n, true) prints it) when the profile changes.
+// CheckBranches() verifies at start-up that every column the selection reads
+// exists in the tree.
+// ========================================================================
+#ifndef CUTS_H
+#define CUTS_H
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "CVUniverse.h"
+#include "TTree.h"
+
+struct SignalMomentumCut {
+  static const char* Type() { return "SignalMomentumCut"; }
+  static const char* Name() { return "103.6 < mom < 104.9"; }
+  static std::vector<ColumnCache::Column> Columns() {
+    return {ColumnCache::kDemMom};
+  }
+  template <class Universe>
+  static bool Pass(const Universe& univ) {
+    const double mom = univ.get_dem_mom();
+    return 103.6 < mom && mom < 104.9;
+  }
+};
+
+struct TimeWindowCut {
+  static const char* Type() { return "TimeWindowCut"; }
+  static const char* Name() { return "640 < t0 < 1650"; }
+  static std::vector<ColumnCache::Column> Columns() {
+    return {ColumnCache::kSignalWindowTime};
+  }
+  template <class Universe>
+  static bool Pass(const Universe& univ) {
+    const double time = univ.get_signal_window_time();
+    return 640. < time && time < 1650.;
+  }
+};
+
+struct MaxRadiusCut {
+  static const char* Type() { return "MaxRadiusCut"; }
+  static const char* Name() { return "450 < maxr < 680"; }
+  static std::vector<ColumnCache::Column> Columns() {
+    return {ColumnCache::kMaxRadius};
+  }
+  template <class Universe>
+  static bool Pass(const Universe& univ) {
+    const double max_radius = univ.get_max_radius();
+    return 450. < max_radius && max_radius < 680.;
+  }
+};
+
+struct TrackQualityCut {
+  static const char* Type() { return "TrackQualityCut"; }
+  static const char* Name() { return "0.2 < trkqual < 1"; }
+  static std::vector<ColumnCache::Column> Columns() {
+    return {ColumnCache::kTrackQual};
+  }
+  template <class Universe>
+  static bool Pass(const Universe& univ) {
+    const double track_qual = univ.get_track_qual();
+    return 0.2 < track_qual && track_qual < 1.;
+  }
+};
+
+struct NActiveHitsCut {
+  static const char* Type() { return "NActiveHitsCut"; }
+  static const char* Name() { return "nactive > 20"; }
+  static std::vector<ColumnCache::Column> Columns() {
+    return {ColumnCache::kNHits};
+  }
+  template <class Universe>
+  static bool Pass(const Universe& univ) {
+    return 20 < univ.get_n_hits();
+  }
+};
+
+template <class... Cuts>
+struct Selection {
+  template <class Universe>
+  static bool Pass(const Universe& univ) {
+    return (Cuts::Pass(univ) && ...);
+  }
+
+  static std::vector<std::string> Names() { return {Cuts::Name()...}; }
+  static std::vector<std::string> Types() { return {Cuts::Type()...}; }
+
+  // Every column the selection reads
+  static ColumnCache::ColumnSet ReadColumns() {
+    ColumnCache::ColumnSet set;
+    for (const auto& columns : {Cuts::Columns()...})
+      for (ColumnCache::Column column : columns) set.set(column);
+    return set;
+  }
+
+  static bool CheckBranches(TTree* tree) {
+    bool ok = true;
+    for (const auto& columns : {Cuts::Columns()...}) {
+      for (ColumnCache::Column column : columns) {
+        const char* branch = ColumnCache::BranchName(column);
+        if (!tree->GetLeaf(branch) && !tree->GetBranch(branch)) {
+          std::cerr << "Selection: branch " << branch << " not in tree\n";
+          ok = false;
+        }
+      }
+    }
+    return ok;
+  }
+
+  // Fraction of entries rejected by each cut on its own, in list order
+  template <class Universe>
+  static std::vector<double> RejectionProfile(Universe& univ,
+                                              Long64_t n_entries) {
+    std::vector<double> rejected(sizeof...(Cuts), 0.);
+    for (Long64_t i = 0; i < n_entries; ++i) {
+      univ.SetEntry(i);
+      size_t icut = 0;
+      ((rejected[icut++] += !Cuts::Pass(univ)), ...);
+    }
+    for (double& r : rejected) r /= std::max<Long64_t>(n_entries, 1);
+    return rejected;
+  }
+
+  template <class Universe>
+  static void PrintRejectionProfile(Universe& univ, Long64_t n_entries) {
+    const std::vector<double> rejected = RejectionProfile(univ, n_entries);
+    const std::vector<std::string> names = Names();
+    const std::vector<std::string> types = Types();
+    std::cout << "Cut rejection over " << n_entries << " entries:\n";
+    for (size_t i = 0; i < names.size(); ++i)
+      std::cout << "  " << names[i] << ": " << rejected[i] << "\n";
+
+    // most rejecting first
+    std::vector<size_t> order(names.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return rejected[a] > rejected[b];
+    });
+    std::cout << "Selection in measured order:\n  typedef Selection<";
+    for (size_t i = 0; i < order.size(); ++i)
+      std::cout << (i ? ", " : "") << types[order[i]];
+    std::cout << "> ...;\n";
+  }
+};
+
+// Cuts from Kate's TrkAna selection
+typedef Selection<SignalMomentumCut, TimeWindowCut, MaxRadiusCut,
+                  TrackQualityCut, NActiveHitsCut>
+    KateSelection;
+
+#endif
@@ -0,0 +1,66 @@
+// ========================================================================
+// A vertical systematic with many random throws, held as one contiguous
+// array of throw values instead of one CVUniverse per throw.
+//
+// Each throw i is a Gaussian shift nsigma[i]. Per entry the band evaluates
+// the fractional weight response per sigma once, computes all N weights in
+// one loop, and fills the N universe histograms of its MnvVertErrorBand in
+// one call. The throws come from a fixed seed, so separate copies of a band
+// (e.g. one per thread) hold identical throws.
+// ========================================================================
+#ifndef MULTIUNIVERSEBAND_H
+#define MULTIUNIVERSEBAND_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "CVUniverse.h"
+#include "PlotUtils/MnvH1D.h"
+#include "TRandom3.h"
+
+class MultiUniverseBand {
+ public:
+  // response(univ) is the fractional weight change per sigma for the entry
+  MultiUniverseBand(const std::string& name, int n_throws, unsigned int seed,
+                    std::function<double(const CVUniverse&)> response)
+      : m_name(name),
+        m_nsigma(n_throws),
+        m_weights(n_throws),
+        m_response(response) {
+    TRandom3 random(seed);
+    for (double& nsigma : m_nsigma) nsigma = random.Gaus();
+  }
+
+  const std::string& GetName() const { return m_name; }
+  int GetNThrows() const { return int(m_nsigma.size()); }
+
+  void AddTo(PlotUtils::MnvH1D* hist) const {
+    if (!hist->HasVertErrorBand(m_name))
+      hist->AddVertErrorBand(m_name, GetNThrows());
+  }
+
+  // All N weights for this entry relative to the CV weight
+  const double* ComputeWeights(const CVUniverse& cv) {
+    const double response = m_response(cv);
+    const double* nsigma = m_nsigma.data();
+    double* weights = m_weights.data();
+    const int n = GetNThrows();
+    for (int i = 0; i < n; ++i) weights[i] = 1 + nsigma[i] * response;
+    return weights;
+  }
+
+  // Fill every throw for an entry that passed the CV cuts
+  void Fill(PlotUtils::MnvH1D* hist, const CVUniverse& cv, double value,
+            double cv_weight) {
+    hist->FillVertErrorBand(m_name, value, ComputeWeights(cv), cv_weight);
+  }
+
+ private:
+  std::string m_name;
+  std::vector<double> m_nsigma;
+  std::vector<double> m_weights;
+  std::function<double(const CVUniverse&)> m_response;
+};
+
+#endif
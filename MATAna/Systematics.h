@@ -2,7 +2,9 @@
 
 #include "CVUniverse.h"
 
-// Lateral universe
+// Lateral universe. A lateral universe must list the columns of the getters
+// it overrides in ShiftedColumns(); without it the event loop re-cuts it on
+// every entry. n hits is read by no cut, so only the variable is re-evaluated.
 class TrackHitCalibrationUniverse : public CVUniverse {
  public:
   TrackHitCalibrationUniverse(PlotUtils::ChainWrapper* chw, double nsigma)
@@ -12,13 +14,19 @@ class TrackHitCalibrationUniverse : public CVUniverse {
     return CVUniverse::get_n_track_hits() + m_nsigma*1; 
   }
 
+  virtual ColumnCache::ColumnSet ShiftedColumns() const override {
+    return ColumnCache::Columns({ColumnCache::kNTrackHits});
+  }
+
   virtual std::string ShortName() const override { return "TrackHitCalibration"; }
   virtual std::string LatexName() const override {
     return "Track N Hits Calibration";
   }
 };
 
-// Vertical universe
+// Vertical universe. A vertical universe must return no ShiftedColumns() so
+// the event loop reuses the CV cuts and variables; without it the universe is
+// re-cut on every entry.
 class ModelXUniverse : public CVUniverse {
  public:
   ModelXUniverse(PlotUtils::ChainWrapper* chw, double nsigma)
@@ -29,6 +37,10 @@ class ModelXUniverse : public CVUniverse {
     return CVUniverse::GetWeight() * (1 + m_nsigma*parameter_tolerance);
   }
 
+  virtual ColumnCache::ColumnSet ShiftedColumns() const override {
+    return ColumnCache::ColumnSet();
+  }
+
   virtual std::string ShortName() const override { return "ModelXUniverse"; }
   virtual std::string LatexName() const override {
     return "Model X";
@@ -0,0 +1,95 @@
+// ========================================================================
+// Schedules the universes of all error bands so that each entry is cut and
+// evaluated once for the CV and only as often as the systematic shifts need.
+//
+// Every universe declares the columns its getters shift (ShiftedColumns(), see
+// CVUniverse.h), and the scheduler is given the columns the selection reads:
+// * vertical: no shifted columns, only GetWeight() changes. The CV cut
+//   decision and CV variable are reused and only the weight is evaluated.
+// * variable-only: shifts columns no cut reads (e.g. TrackHitCalibration on
+//   the plotted n hits). The CV cut decision is reused and only the variable
+//   is re-evaluated, for entries the CV selects.
+// * lateral: shifts a column a cut reads, so it is cut and evaluated on its
+//   own.
+// The cost per entry then grows with the number of shifts of cut variables
+// rather than with the total number of universes.
+//
+// The universe vectors are flattened once at construction, so nothing is
+// copied per entry.
+// ========================================================================
+#ifndef UNIVERSESCHEDULER_H
+#define UNIVERSESCHEDULER_H
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "CVUniverse.h"
+
+class UniverseScheduler {
+ public:
+  // cut_columns: every column the selection reads (e.g. Selection::ReadColumns())
+  UniverseScheduler(
+      const std::map<std::string, std::vector<CVUniverse*> >& error_bands,
+      ColumnCache::ColumnSet cut_columns)
+      : m_cv(nullptr) {
+    for (const auto& band : error_bands) {
+      for (CVUniverse* universe : band.second) {
+        const ColumnCache::ColumnSet shifted = universe->ShiftedColumns();
+        if (band.first == "CV" && !m_cv)
+          m_cv = universe;
+        else if (shifted.none())
+          m_vertical.push_back(universe);
+        else if ((shifted & cut_columns).none())
+          m_variable_only.push_back(universe);
+        else
+          m_lateral.push_back(universe);
+      }
+    }
+    if (!m_cv) {
+      std::cerr << "UniverseScheduler: no CV universe in the error bands\n";
+      exit(1);
+    }
+  }
+
+  // pass(univ) applies the selection, value(univ) returns the value to fill
+  // and fill(univ, value, weight) fills univ's histograms.
+  template <class Pass, class Value, class Fill>
+  void ProcessEntry(Long64_t entry, Pass&& pass, Value&& value, Fill&& fill) const {
+    m_cv->SetEntry(entry);
+    if (pass(*m_cv)) {
+      const auto cv_value = value(*m_cv);
+      fill(*m_cv, cv_value, m_cv->GetWeight());
+      for (CVUniverse* universe : m_vertical) {
+        universe->SetEntry(entry);
+        fill(*universe, cv_value, universe->GetWeight());
+      }
+      for (CVUniverse* universe : m_variable_only) {
+        universe->SetEntry(entry);
+        fill(*universe, value(*universe), universe->GetWeight());
+      }
+    }
+
+    for (CVUniverse* universe : m_lateral) {
+      universe->SetEntry(entry);
+      if (pass(*universe))
+        fill(*universe, value(*universe), universe->GetWeight());
+    }
+  }
+
+  CVUniverse* GetCV() const { return m_cv; }
+  const std::vector<CVUniverse*>& GetVertical() const { return m_vertical; }
+  const std::vector<CVUniverse*>& GetVariableOnly() const {
+    return m_variable_only;
+  }
+  const std::vector<CVUniverse*>& GetLateral() const { return m_lateral; }
+
+ private:
+  CVUniverse* m_cv;
+  std::vector<CVUniverse*> m_vertical;
+  std::vector<CVUniverse*> m_variable_only;
+  std::vector<CVUniverse*> m_lateral;
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef _BatchConfig_hh
+#define _BatchConfig_hh
+/*
+Job list for batch mode: many fits in one ReferenceAna process, read from a FHiCL file
+
+  output : "ReferenceAnaBatch.root"
+  per_process : false
+  checkpoint : "ReferenceAnaBatch.ckpt"   # optional, with checkpoint_interval (s) and checkpoint_entries
+  plots : true                            # fit plots and NLL scans per job, <plot>_<job>.root
+  jobs : [
+    { name : "pass0b_unbinned" file : "nts...tka" run : "pass0b" usecuts : true fit : "unbinned" mom_lo : 95 mom_hi : 106 },
+    { name : "pass0b_morph" file : "nts...tka" run : "pass0b" fit : "morph" templates : "templates.root" },
+    { name : "pass0b_t0" file : "nts...tka" run : "pass0b" fit : "multi" observables : ["t0"] },
+    ...
+  ]
+  combined : [
+    { name : "pass0ab" threads : 2 categories : [
+        { name : "pass0a" file : "nts...tka" run : "pass0a" },
+        { name : "pass0b" file : "nts...tka" run : "pass0b" captures : 1.2e13 } ] }
+  ]
+
+A combined fit is one simultaneous fit over its categories (run periods), with a shared
+Rmue; the categories of a combined fit are not fitted on their own.
+*/
+#include <vector>
+#include "TString.h"
+
+namespace rootfitter{
+
+  struct FitJob {
+    TString name;
+    TString filename;
+    TString runname;
+    bool    usecuts = true;
+    TString type = "unbinned"; // binned, unbinned, systematics, morph, multi or bootstrap
+    unsigned int threads = 1;
+    TString templates;         // morph: templates file, empty to build them from the ntuple
+    int     template_bins = 110;
+    int     observables = 3;   // multi: FitObservable bits of the extra observables, t0 = 1, trkqual = 2
+    unsigned int replicas = 100; // bootstrap
+    ULong64_t seed = 12345;      // bootstrap, goodness-of-fit toys
+    unsigned int gof_toys = 100; // unbinned: toys for the KS/AD p-values, 0 for the statistics only
+    double  captures = 0;      // combined fits: muon captures in this category, 0 to derive them from the DIO yield
+    double  mom_lo = 95;
+    double  mom_hi = 106;
+    // FNV-1a hash of everything that defines the fit; the name is excluded
+    ULong64_t ConfigHash() const;
+  };
+
+  struct CombinedFit {
+    TString name;
+    unsigned int threads = 1; // processes evaluating the category NLLs
+    std::vector<FitJob> categories;
+    ULong64_t ConfigHash() const;
+  };
+
+  struct BatchConfig {
+    TString output = "ReferenceAnaBatch.root";
+    bool    per_process = false; // write a per-process shard of the results store
+    TString checkpoint;          // checkpoint file prefix, empty for none
+    double  checkpoint_interval = 300;      // minimum seconds between checkpoints of a selection loop
+    Long64_t checkpoint_entries = 10000;    // entries between looks at the clock
+    bool    plots = true;        // fit plots and NLL scans, one file per job
+    std::vector<FitJob> jobs;
+    std::vector<CombinedFit> combined;
+  };
+
+  // independent fits run as sharded processes, see Campaign.hh
+  //   name : "toys" type : "toys" items : 1000 shards : 16 workers : 8 retries : 2 seed : 12345
+  //   output : "toys.root" mom_lo : 95 mom_hi : 106 nsig : 5 ndio : 1000 ncosmics : 1
+  //   file : "nts...tka" run : "pass0b" usecuts : true  (scan and universes)
+  //   scan_lo : 0 scan_hi : 20  (scan)   files : [ "nts...tka", ... ]  (files)
+  struct CampaignConfig {
+    TString name = "campaign";
+    TString type = "toys";       // toys, scan, universes or files
+    TString output = "ReferenceAnaCampaign.root";
+    unsigned int items = 100;    // toys and scan points; universes and files: all of them
+    unsigned int shards = 1;
+    unsigned int workers = 1;    // shard processes running at once
+    unsigned int retries = 2;    // extra attempts per failed shard
+    ULong64_t seed = 12345;      // toys: toy i is generated with ItemSeed(seed, i)
+    FitJob job;                  // ntuple, cuts and momentum window
+    std::vector<TString> files;  // files: one item per file
+    double nsig = 5;             // toys: generated yields
+    double ndio = 1000;
+    double ncosmics = 1;
+    double scan_lo = 0;          // scan: nsig fixed at items points from scan_lo to scan_hi
+    double scan_hi = 20;
+    double checkpoint_interval = 60; // seconds between flushes of a shard's store; a rerun shard skips the items found there
+    // everything that defines the results; shards, workers and retries are excluded
+    ULong64_t ConfigHash() const;
+  };
+
+  BatchConfig ReadBatchConfig(TString filename);
+  CampaignConfig ReadCampaignConfig(TString filename);
+  bool ParseBool(TString value, bool& result);
+}
+#endif /* BatchConfig.hh */
@@ -0,0 +1,66 @@
+#ifndef _Bootstrap_hh
+#define _Bootstrap_hh
+/*
+Poisson bootstrap of the momentum fit. One checkpointable pass over the ntuple (which
+also fills the MC truth counts) keeps the candidates; each then gets a Poisson(1) weight
+per replica and is added to each replica's weighted dataset. The replicas are then
+fitted in parallel worker processes (FitInParallel). The spread of the replica results
+is a data-driven uncertainty on nsig and Rmue that keeps the real momentum distribution.
+
+The weights come from a counter-based generator: the weight of a candidate in a replica
+depends only on the seed, the ntuple entry, the candidate index in the entry and the
+replica, not on the order in which candidates are visited. Splitting the loop between
+threads or files therefore gives the same replicas.
+*/
+#include <vector>
+#include "TTree.h"
+#include "ReferenceAna/inc/FitResultStore.hh"
+
+namespace rootfitter{
+  class TruthCounts;
+  class LoopCheckpoint;
+
+  // SplitMix64 finaliser, a bijective 64-bit mix
+  inline ULong64_t MixBits(ULong64_t x){
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30))*0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27))*0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+  }
+
+  // uniform in [0, 1) for (seed, counter, stream)
+  inline double CounterUniform(ULong64_t seed, ULong64_t counter, ULong64_t stream){
+    ULong64_t bits = MixBits(MixBits(MixBits(seed) ^ counter) ^ stream);
+    return (bits >> 11)*(1.0/9007199254740992.0); // 53 bits
+  }
+
+  // Poisson(1) by inversion
+  inline int PoissonOne(double u){
+    double p = 0.36787944117144233; // exp(-1)
+    double cdf = p;
+    int k = 0;
+    while(u >= cdf and k < 20){
+      ++k;
+      p /= k;
+      cdf += p;
+    }
+    return k;
+  }
+
+  struct BootstrapResult {
+    FitRecord nominal;
+    std::vector<FitRecord> replicas;
+    double nsig_mean = 0;
+    double nsig_rms = 0;
+    double ndio_rms = 0;
+    double rmue_mean = 0;
+    double rmue_rms = 0;
+  };
+
+  // truth, if given, is filled in the same pass over the ntuple; checkpoint, if given,
+  // resumes the pass from its last save and saves it periodically
+  BootstrapResult RunBootstrap(TTree *trkana, bool usecuts, double mom_lo, double mom_hi,
+                               unsigned int n_replicas, ULong64_t seed, unsigned int n_threads,
+                               TruthCounts *truth = 0, LoopCheckpoint *checkpoint = 0);
+}
+#endif /* Bootstrap.hh */
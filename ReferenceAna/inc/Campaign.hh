@@ -0,0 +1,43 @@
+#ifndef _Campaign_hh
+#define _Campaign_hh
+/*
+Campaigns of independent fits (toys, fixed-nsig scan points, systematic universes or
+files) run as several local processes, so a campaign can fill a batch node and survive
+a crashed worker. The items are split into contiguous shards; each shard is a
+ReferenceAna process writing its own result store, and the launcher keeps up to
+`workers` shards running and reruns a shard that fails. Merging orders the rows by item.
+
+Random numbers are seeded per item (ItemSeed), not per process, and every fit starts
+from the model's initial values, so an item gives the same fit whichever shard runs it
+and the merged result does not depend on the number of shards. The timing columns are
+zeroed in the merged store (they stay in the shard stores).
+
+The shard stores double as checkpoints: they are flushed every checkpoint_interval
+seconds, and a shard that is rerun (after a retry or a restarted campaign) skips the
+items already stored with the same configuration.
+*/
+#include <functional>
+#include <utility>
+#include "TString.h"
+#include "TTree.h"
+#include "ReferenceAna/inc/BatchConfig.hh"
+#include "ReferenceAna/inc/Bootstrap.hh"
+
+namespace rootfitter{
+
+  inline ULong64_t ItemSeed(ULong64_t seed, unsigned int item){ return MixBits(MixBits(seed) ^ item); }
+
+  // number of work items: toys or scan points, universes or files
+  unsigned int CampaignItems(const CampaignConfig &config);
+  // [first, last) items of a shard
+  std::pair<unsigned int, unsigned int> ShardItems(unsigned int n_items, unsigned int n_shards, unsigned int shard);
+  TString ShardFilename(const CampaignConfig &config, unsigned int shard);
+
+  // worker: fits the items of one shard into ShardFilename; open returns the TrkAna tree of a file
+  int RunCampaignShard(const CampaignConfig &config, unsigned int shard, std::function<TTree*(TString)> open);
+  // launcher: runs `executable --campaign-shard <configname> <shard>` for every shard, then merges
+  int RunCampaign(TString configname, TString executable);
+  // shard stores -> config.output in item order; fails if an item is missing
+  bool MergeCampaign(const CampaignConfig &config);
+}
+#endif /* Campaign.hh */
@@ -0,0 +1,54 @@
+#ifndef _Checkpoint_hh
+#define _Checkpoint_hh
+/*
+Checkpoints for the selection loops, so a pre-empted job resumes where it stopped
+instead of at entry zero. A checkpoint holds the number of entries done and the partial
+loop state: momentum histogram, candidate tree and MC truth counters. Restoring it and
+processing the remaining entries fills exactly the same objects as an uninterrupted loop.
+The systematics and bootstrap loops keep their candidates in such a tree and build their
+weighted datasets from it after the loop.
+
+Each save writes a new file and renames it over the previous checkpoint, so a job killed
+while saving still has the last complete one. Saves happen at most every interval_s
+seconds, and the clock is read only every check_every entries, which bounds the cost.
+The checkpoint records the input (file, entries, cuts) it belongs to and is ignored for
+any other input.
+*/
+#include "TString.h"
+#include "TH1.h"
+#include "TTree.h"
+#include "ReferenceAna/inc/TruthCounts.hh"
+
+namespace rootfitter{
+
+  // identifies the input of a selection loop for its checkpoint
+  TString LoopInput(TTree *trkana, bool usecuts, int fitted = 0);
+
+  class LoopCheckpoint {
+    public:
+      // an empty filename disables checkpointing
+      LoopCheckpoint(TString filename, double interval_s = 300, Long64_t check_every = 10000);
+      LoopCheckpoint(const LoopCheckpoint &) = delete;
+      LoopCheckpoint& operator = (const LoopCheckpoint &) = delete;
+
+      bool Enabled() const { return filename != ""; }
+      // fills hist, tree and truth (any may be 0) from a checkpoint of the same input;
+      // returns the first entry still to process
+      Long64_t Restore(TString input, TH1 *hist, TTree *tree, TruthCounts *truth);
+      // call after each entry; saves when due
+      void Update(Long64_t entries_done, const TH1 *hist, TTree *tree, const TruthCounts *truth){
+        if(Enabled() and entries_done % check_every == 0 and Due()) Save(entries_done, hist, tree, truth);
+      }
+      void Save(Long64_t entries_done, const TH1 *hist, TTree *tree, const TruthCounts *truth);
+      void Remove();
+
+    private:
+      bool Due() const;
+      TString filename;
+      TString input;
+      double interval_s;
+      Long64_t check_every;
+      double last_save;
+  };
+}
+#endif /* Checkpoint.hh */
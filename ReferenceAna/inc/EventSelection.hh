@@ -0,0 +1,114 @@
+#ifndef _EventSelection_hh
+#define _EventSelection_hh
+/*
+Per-event candidate selection on the TrkAna ntuple. Shared by the event loops in
+ReferenceAna_main.cc and by the benchmark executable so both time the same code.
+*/
+#include <cmath>
+#include <vector>
+#include "TTree.h"
+
+#include "TrkAna/inc/CrvHitInfoReco.hh"
+#include "TrkAna/inc/MVAResultInfo.hh"
+#include "TrkAna/inc/TrkInfo.hh"
+#include "TrkAna/inc/SimInfo.hh"
+
+namespace rootfitter{
+
+  // track and CRV coincidence closer than this in time (ns) are vetoed
+  const double kCrvVetoWindow = 150;
+
+  // branch buffers for one TrkAna entry
+  struct TrkAnaEvent {
+    std::vector<std::vector<mu2e::TrkFitInfo> >* tracks = 0;
+    std::vector<mu2e::CrvHitInfoReco>* crvcoincs = 0;
+    mu2e::MVAResultInfo* trkquals = 0;
+    std::vector<std::vector<mu2e::LoopHelixInfo>>* lhs = 0;
+    std::vector<std::vector<mu2e::SimInfo>>* sims = 0;
+
+    void SetBranchAddresses(TTree *trkana){
+      trkana->SetBranchAddress("demfit", &tracks);
+      trkana->SetBranchAddress("crvcoincs", &crvcoincs);
+      trkana->SetBranchAddress("demtrkqual", &trkquals);
+      trkana->SetBranchAddress("demlh", &lhs);
+      trkana->SetBranchAddress("demmcsim", &sims);
+    }
+  };
+
+  // observables fitted in the multi-observable likelihood instead of being cut on
+  enum FitObservable { kFitT0 = 1, kFitTrkQual = 2 };
+
+  // MC truth origin of an event, see ClassifyTruth
+  enum TruthOrigin { kOriginCE, kOriginDIO, kOriginOther, kNOrigins };
+  // cumulative: an event counted at a stage passed all the earlier ones
+  enum CutStage { kStageAll, kStageTrack, kStageLHCuts, kStageCrvVeto, kStageWindow, kNStages };
+
+  inline bool PassesLHCuts(const TrkAnaEvent& event, bool usecuts, int fitted = 0){
+    bool passes_lhcuts = false;
+    for (auto& lh : *event.lhs) {
+      if(lh.size() > 0){
+        if(!usecuts) return true;
+        bool passes_trkqual = (fitted & kFitTrkQual) or event.trkquals->result > 0.2;
+        bool passes_t0 = (fitted & kFitT0) or lh[0].t0 > 700;
+        if(passes_trkqual and passes_t0 and lh[0].t0err < 0.9 and lh[0].maxr < 680){
+          passes_lhcuts = true;
+        }
+      }
+    }
+    return passes_lhcuts;
+  }
+
+  // t0 of the first loop helix fit, the one the LH cuts look at first
+  inline double EventT0(const TrkAnaEvent& event){
+    for (auto& lh : *event.lhs) {
+      if(lh.size() > 0) return lh[0].t0;
+    }
+    return 0;
+  }
+
+  // MC start code of the event's primary (166 DIO, 167 CE), 0 if there is no truth
+  inline int PrimaryStartCode(const TrkAnaEvent& event){
+    return (event.sims->size() > 0 and event.sims->at(0).size() > 0) ? event.sims->at(0).at(0).startCode : 0;
+  }
+
+  inline TruthOrigin ClassifyTruth(const TrkAnaEvent& event){
+    int start_code = PrimaryStartCode(event);
+    if(start_code == 167) return kOriginCE;
+    if(start_code == 166) return kOriginDIO;
+    return kOriginOther;
+  }
+
+  inline bool HasCrvCoincidence(double track_time, const std::vector<mu2e::CrvHitInfoReco>& crvcoincs){
+    for (auto& crvcoinc : crvcoincs) {
+      if (std::fabs(crvcoinc.time - track_time) < kCrvVetoWindow) return true;
+    }
+    return false;
+  }
+
+  struct NoStage { void operator()(CutStage, const mu2e::TrkFitInfo*) const {} };
+
+  // calls candidate(fit) for every sid==0 fit passing the LH cuts and the CRV veto, then
+  // stage(last stage passed, leading sid==0 fit or 0) with kStageAll, kStageTrack,
+  // kStageLHCuts or kStageCrvVeto (the momentum window is up to the caller)
+  template <class F, class S = NoStage> void ForEachCandidate(const TrkAnaEvent& event, bool usecuts, F&& candidate, int fitted = 0, S&& stage = S()){
+    const mu2e::TrkFitInfo *leading = 0;
+    for (auto& track : *event.tracks) {
+      for (auto& fit : track) {
+        if(fit.sid == 0 and !leading) leading = &fit;
+      }
+    }
+    if(!leading) { stage(kStageAll, leading); return; }
+    if(!PassesLHCuts(event, usecuts, fitted)) { stage(kStageTrack, leading); return; }
+    CutStage passed = kStageLHCuts;
+    for (auto& track : *event.tracks) {
+      for (auto& fit : track) {
+        if (fit.sid == 0 and !HasCrvCoincidence(fit.time, *event.crvcoincs)) {
+          passed = kStageCrvVeto;
+          candidate(fit);
+        }
+      }
+    }
+    stage(passed, leading);
+  }
+}
+#endif /* EventSelection.hh */
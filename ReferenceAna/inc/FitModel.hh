@@ -0,0 +1,95 @@
+#ifndef _FitModel_hh
+#define _FitModel_hh
+/*
+The CE + DIO + cosmic momentum model as one object that owns its variables and PDFs,
+so it can be fitted to several datasets.
+
+Fits are not run on several threads at once: migrad and hesse touch RooFit global state
+(evaluation-error logging, the name registry, the message service), which RooFit does not
+protect. Fits are parallelised with processes instead: independent fits (universes,
+replicas, goodness-of-fit toys) are spread over forked workers by FitInProcesses, the NLL
+of one large fit is split over n_cpu processes (RooFit NumCPU), and campaigns spread their
+items over worker processes (Campaign.hh).
+*/
+#include <functional>
+#include <vector>
+#include "RooRealVar.h"
+#include "RooAddPdf.h"
+#include "RooUniform.h"
+#include "RooAbsData.h"
+#include "RooFitResult.h"
+#include "ReferenceAna/inc/RooDSCB.hh"
+#include "ReferenceAna/inc/RooPol58.hh"
+#include "ReferenceAna/inc/FitResultStore.hh"
+
+namespace rootfitter{
+  const int kMinEntriesPerCpu = 10000;
+
+  class FitModel {
+    public:
+      FitModel(double mom_lo, double mom_hi);
+      FitModel(const FitModel &) = delete;
+      FitModel& operator = (const FitModel &) = delete;
+
+      RooRealVar& Momentum() { return recomom; }
+      RooAddPdf& Pdf() { return fitFun; }
+      RooDSCB& Signal() { return Sig; }
+      RooPol58& DIOShape() { return DIO; }
+      RooUniform& CosmicShape() { return Cosmic; }
+      RooRealVar& SignalMean() { return mean; }
+      RooRealVar& NSig() { return nsig; }
+      RooRealVar& NDIO() { return ndio; }
+      RooRealVar& NCosmics() { return ncosmics; }
+      const RooRealVar& NSig() const { return nsig; }
+      const RooRealVar& NDIO() const { return ndio; }
+      const RooRealVar& NCosmics() const { return ncosmics; }
+      double Rmue() const;
+
+      // every parameter back to its value and error at construction, so a reused model fits like a new one
+      void Reset();
+      // start values for the next fit, e.g. the CV result for a systematic refit
+      void SetParameters(const RooArgList &values);
+      // migrad + hesse, the NLL evaluated by up to n_cpu processes (at most one per
+      // kMinEntriesPerCpu entries, since a forked NLL server costs more than a small NLL)
+      RooFitResult *Fit(RooAbsData &data, unsigned int n_cpu = 1);
+
+    private:
+      RooRealVar recomom;
+      // CE double-sided crystal ball
+      RooRealVar mean;
+      RooRealVar sigma;
+      RooRealVar ANeg;
+      RooRealVar PNeg;
+      RooRealVar APos;
+      RooRealVar PPos;
+      // DIO pol58 coefficients
+      RooRealVar a5;
+      RooRealVar a6;
+      RooRealVar a7;
+      RooRealVar a8;
+      RooRealVar nsig;
+      RooRealVar ndio;
+      RooRealVar ncosmics;
+      RooDSCB Sig;
+      RooPol58 DIO;
+      RooUniform Cosmic;
+      RooAddPdf fitFun;
+      RooArgSet params;
+      RooArgSet initial; // owns the snapshot
+  };
+
+  // fits data from the model's current parameters and fills record with the result and the fit time
+  void FitAndRecord(FitModel &model, RooAbsData &data, FitRecord &record, unsigned int n_cpu = 1);
+
+  // runs fit(i, records[i]) for every i < n_items, in n_workers forked processes that each
+  // take a contiguous block of items and return their records in a FitResultStore file.
+  // Items a worker did not return (crash, failed fork) are fitted in this process.
+  void FitInProcesses(unsigned int n_items, unsigned int n_workers,
+                      const std::function<void(unsigned int, FitRecord&)> &fit, std::vector<FitRecord> &records);
+
+  // fits every dataset over n_workers processes (FitInProcesses), each fit starting from
+  // start (e.g. a CV result) if given; records[i] gets the result for data[i]
+  void FitInParallel(const std::vector<RooAbsData*> &data, const RooArgList *start, double mom_lo, double mom_hi,
+                     unsigned int n_workers, std::vector<FitRecord> &records);
+}
+#endif /* FitModel.hh */
@@ -0,0 +1,78 @@
+#ifndef _FitResultStore_hh
+#define _FitResultStore_hh
+/*
+Append-only store for fit results: one TTree row per fit, one branch per column, so
+comparisons over thousands of fits read only the columns they need.
+
+Threads may share one store (Append is serialised). Processes each write their own
+shard (per-process file name) and the shards are combined with Merge, which fast-clones
+the baskets instead of re-reading the rows.
+*/
+#include <mutex>
+#include <vector>
+#include "TString.h"
+#include "TFile.h"
+#include "TTree.h"
+#include "RooFitResult.h"
+#include "ReferenceAna/inc/EventSelection.hh"
+
+namespace rootfitter{
+
+  // yields are ordered nsig, ndio, ncosmics in errors and covariance
+  struct FitRecord {
+    TString  name;
+    ULong64_t config_hash = 0;
+    double nsig = 0;
+    double ndio = 0;
+    double ncosmics = 0;
+    double nsig_err = 0;
+    double ndio_err = 0;
+    double ncosmics_err = 0;
+    double cov[9] = {0};
+    double rmue = 0;
+    int    status = -1;
+    int    covqual = -1;
+    double edm = 0;
+    double minnll = 0;
+    double fit_wall_s = 0;
+    double fit_cpu_s = 0;
+    double mc_nce = 0;
+    double mc_ndio = 0;
+    double confusion[kNOrigins*2] = {0};       // MC truth origin (CE, DIO, other) x (rejected, selected), see TruthCounts
+    double cutflow[kNOrigins*kNStages] = {0};  // MC truth origin x cut stage (all, track, lhcuts, crvveto, window)
+    double ks = 0;                             // unbinned goodness of fit, see GoodnessOfFit
+    double ad = 0;
+    double ks_pvalue = -1;                     // -1: not computed
+    double ad_pvalue = -1;
+  };
+
+  // copies status, EDM, yields, their errors and covariance from a fit result
+  void FillFitRecord(const RooFitResult &result, FitRecord &record);
+
+  class FitResultStore {
+    public:
+      // per_process appends ".<host>.<pid>" to the file name so each process writes its own shard
+      explicit FitResultStore(TString filename, bool per_process = false);
+      ~FitResultStore() { Close(); }
+      FitResultStore(const FitResultStore &) = delete;
+      FitResultStore& operator = (const FitResultStore &) = delete;
+      void Append(const FitRecord &record);
+      void Flush(); // rows appended so far are readable by other processes
+      // writes object into directory dirname of the store's file (e.g. validation histograms)
+      void WriteObject(const TObject &object, TString dirname);
+      void Close();
+      TString GetFilename() const { return fFilename; }
+      static bool Merge(const std::vector<TString> &shards, TString output);
+      // appends the rows of a store to records
+      static bool Read(TString filename, std::vector<FitRecord> &records);
+    private:
+      std::mutex fMutex;
+      TString fFilename;
+      TFile *fFile = 0;
+      TTree *fTree = 0;
+      FitRecord fRow;
+      TString *fNamePtr = 0;
+      Long64_t fNSinceSave = 0;
+  };
+}
+#endif /* FitResultStore.hh */
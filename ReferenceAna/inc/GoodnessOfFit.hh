@@ -0,0 +1,55 @@
+#ifndef _GoodnessOfFit_hh
+#define _GoodnessOfFit_hh
+/*
+Unbinned goodness of fit for the momentum fit: Kolmogorov-Smirnov and Anderson-Darling
+statistics of the sorted momentum column against the fitted model's CDF, with no
+histogram or plot. The CDF is tabulated once per fit from the model PDF (cumulative
+trapezoid on a fine grid) and interpolated.
+
+The parameters are fitted to the same data, so the textbook KS/AD distributions do not
+apply; the p-values come from toys. As the fit is extended, each toy draws a Poisson
+number of momenta around the data size from the fitted CDF (counter-based uniforms keyed
+on the seed and the toy, so the toys do not depend on how they are run), is refitted, and
+is tested against its own fitted CDF. The toys are spread over n_workers forked worker
+processes (FitInProcesses, FitModel.hh), one FitModel per worker.
+*/
+#include <vector>
+#include "TTree.h"
+#include "RooAbsPdf.h"
+#include "RooRealVar.h"
+#include "ReferenceAna/inc/FitModel.hh"
+
+namespace rootfitter{
+
+  class TabulatedCdf {
+    public:
+      TabulatedCdf(RooAbsPdf &pdf, RooRealVar &x, int n_points = 2048);
+      double operator()(double x) const;
+      double Inverse(double u) const;
+    private:
+      double lo;
+      double step;
+      std::vector<double> cdf;
+  };
+
+  struct GofResult {
+    double ks = 0;
+    double ad = 0;
+    double ks_pvalue = -1; // -1: no toys
+    double ad_pvalue = -1;
+    unsigned int n_toys = 0; // toys with a converged fit
+  };
+
+  // KS distance and AD A^2 of sorted values against cdf
+  void EdfStatistics(const std::vector<double> &sorted, const TabulatedCdf &cdf, double &ks, double &ad);
+  // values of branch in [lo, hi], sorted
+  std::vector<double> SortedColumn(TTree *tree, const char *branch, double lo, double hi);
+  // counter of the uniform that draws a toy's size; the momenta use counters 0, 1, ...
+  const ULong64_t kToySizeCounter = ~0ULL;
+  // Poisson(mean) by inversion of u in [0, 1)
+  unsigned int PoissonCount(double mean, double u);
+  // fitted is the model after the fit to sorted; it is not changed
+  GofResult UnbinnedGoodnessOfFit(const std::vector<double> &sorted, FitModel &fitted,
+                                  unsigned int n_toys, ULong64_t seed, unsigned int n_workers);
+}
+#endif /* GoodnessOfFit.hh */
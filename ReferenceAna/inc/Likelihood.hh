@@ -26,6 +26,7 @@
 #include "TAttFill.h"
 // add roofit header files
 #include "RooHist.h"
+#include "RooCurve.h"
 #include "RooRealVar.h"
 #include "RooPlot.h"
 #include "RooDataSet.h"
@@ -45,11 +46,26 @@
 //My stuff
 #include "ReferenceAna/inc/RooPol58.hh"
 #include "ReferenceAna/inc/RooDSCB.hh"
+#include "ReferenceAna/inc/FitResultStore.hh"
+#include "ReferenceAna/inc/FitModel.hh"
+#include "ReferenceAna/inc/GoodnessOfFit.hh"
+#include<map>
+#include<memory>
 #include<tuple>
+#include<utility>
+#include<vector>
 using namespace std;
 using namespace TMath;
 using namespace RooFit;
 namespace rootfitter{
+  struct MomentumTemplates;
+
+  // one dataset (e.g. run period) of a simultaneous fit
+  struct FitCategory {
+    TString name;
+    TTree  *mom = 0;     // selected reco momenta, as for the unbinned fit
+    double  captures = 0; // muon captures (exposure); 0 to derive them from the fitted DIO yield
+  };
   class Likelihood  {
       public:
         explicit Likelihood(){};
@@ -59,16 +75,31 @@ namespace rootfitter{
         #ifndef __CINT__
         TString GetLabel(TString run);
         std::tuple <RooRealVar, RooRealVar, RooRealVar, RooRealVar>  CE_parameters();
-        std::tuple <RooRealVar, RooRealVar, RooRealVar, RooRealVar>  DIO_parameters();
         std::tuple <RooRealVar, RooRealVar>  RPC_parameters();
-        std::tuple <RooRealVar, RooRealVar, RooRealVar, RooRealVar,RooRealVar, RooRealVar> CE_DSCB();
-        template <class T> void MakePlots(RooRealVar recomom, T chMom, RooAddPdf fitFun, TString tag, TString recocuts);
-        RooFitResult *CalculateBinnedLikelihood(TH1F *hist_mom1, TString runname, bool usecuts, double mom_lo, double mom_hi, std::tuple <double, double, double, double>& recoresult);
-        template <class T> RooFitResult *  MakeLikelihood(RooAddPdf &fitFun, T chMom, RooRealVar nsig, RooRealVar recomom);
-        template <class T> RooFitResult *  MakeProfileLikelihood(RooAddPdf &fitFun, T chMom, RooRealVar nsig, RooRealVar recomom);
-        double ReturnRmu(RooRealVar nsig, RooRealVar ndio);
-        RooFitResult * CalculateUnbinnedLikelihood(TTree *mom, TString runname, bool usecuts, double mom_lo, double mom_hi,  std::tuple <double, double, double, double>& recoresult);
+        // the CE + DIO + cosmic model for this momentum window, built on first use and
+        // reset to its start values on every call
+        FitModel& Model(double mom_lo, double mom_hi);
+        // plots and NLL scans go to <stem>_<name>.root (<stem>.root for an empty name); none if !plots
+        void SetPlotOutput(TString name, bool plots = true);
+        template <class T> void MakePlots(RooRealVar &recomom, T &chMom, RooAbsPdf &fitFun, TString tag, TString recocuts);
+        RooFitResult *CalculateBinnedLikelihood(TH1F *hist_mom1, TString runname, bool usecuts, double mom_lo, double mom_hi, FitRecord& record);
+        RooFitResult *Minimize(RooMinimizer &m);
+        template <class T> RooFitResult *  MakeLikelihood(RooAbsPdf &fitFun, T &chMom, RooRealVar &nsig, RooRealVar &recomom);
+        template <class T> RooFitResult *  MakeProfileLikelihood(RooAbsPdf &fitFun, T &chMom, RooRealVar &nsig, RooRealVar &recomom);
+        // KS/AD of the last unbinned fit in this window against the same momenta, p-values from n_toys toys
+        GofResult GoodnessOfFit(TTree *mom, double mom_lo, double mom_hi, unsigned int n_toys, ULong64_t seed, unsigned int n_workers);
+        static double ReturnRmu(const RooAbsReal &nsig, const RooAbsReal &ndio);
+        RooFitResult * CalculateUnbinnedLikelihood(TTree *mom, TString runname, bool usecuts, double mom_lo, double mom_hi, FitRecord& record);
+        RooFitResult * CalculateSimultaneousLikelihood(const std::vector<FitCategory> &categories, double mom_lo, double mom_hi, unsigned int n_cpu, std::vector<FitRecord>& records);
+        RooFitResult * CalculateMultiObservableLikelihood(TTree *mom, int fitted, TString runname, bool usecuts, double mom_lo, double mom_hi, FitRecord& record);
+        RooFitResult * CalculateMorphedLikelihood(TTree *mom, const MomentumTemplates &templates, TString runname, bool usecuts, double mom_lo, double mom_hi, FitRecord& record);
         #endif
+      private:
+        RooFitResult *FitAndPlot(FitModel &model, RooAbsData &chMom, TString tag, TString recocuts, FitRecord& record);
+        TString PlotName(TString stem) const;
+        TString fPlotName; //!
+        bool fPlots = true; //!
+        std::map<std::pair<double, double>, std::unique_ptr<FitModel> > fModels; //!
         ClassDef (Likelihood,1);
 
     };
@@ -0,0 +1,59 @@
+#ifndef _OnlineFit_hh
+#define _OnlineFit_hh
+/*
+Online mode: watch a directory of TrkAna files during a production campaign. Each new
+file goes through the selection once; its candidates are added to an accumulated
+momentum histogram and dataset that live for the whole run. Every update refits the
+accumulated data starting from the previous fit result, so an update costs the
+selection of the new files plus one warm-started fit.
+
+A file is only read once its size has been the same for two polls, so files that are
+still being copied in are left for later.
+*/
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+#include "TString.h"
+#include "TH1F.h"
+#include "RooDataSet.h"
+#include "RooFitResult.h"
+#include "ReferenceAna/inc/FitModel.hh"
+#include "ReferenceAna/inc/FitResultStore.hh"
+#include "ReferenceAna/inc/TruthCounts.hh"
+
+namespace rootfitter{
+  class OnlineFit {
+    public:
+      // binned refits the accumulated histogram (cost independent of the number of candidates),
+      // otherwise the accumulated unbinned dataset
+      OnlineFit(TString directory, bool usecuts, double mom_lo, double mom_hi, bool binned = true);
+      OnlineFit(const OnlineFit &) = delete;
+      OnlineFit& operator = (const OnlineFit &) = delete;
+
+      // .tka files that are complete and not processed yet, in name order
+      std::vector<TString> NewFiles();
+      // selection on one file; returns the number of candidates added
+      Long64_t AddFile(TString filename);
+      // warm-started refit of everything accumulated so far; the result is kept for the next update
+      const RooFitResult &Update(FitRecord &record);
+
+      const TH1F& Histogram() const { return hist; }
+      const RooDataSet& Data() const { return data; }
+      const TruthCounts& Truth() const { return truth; }
+      unsigned int NFiles() const { return processed.size(); }
+
+    private:
+      TString directory;
+      bool usecuts;
+      bool binned;
+      FitModel model;
+      RooDataSet data;
+      TH1F hist;
+      std::set<TString> processed;
+      std::map<TString, Long64_t> sizes; // size at the last poll, for files not processed yet
+      std::unique_ptr<RooFitResult> last;
+      TruthCounts truth;
+  };
+}
+#endif /* OnlineFit.hh */
@@ -73,6 +73,40 @@ class RooDSCB : public RooAbsPdf {
       return result;
     }
 
+  public:
+    // closed-form normalisation over x, so RooFit never integrates the DSCB numerically
+    Int_t getAnalyticalIntegral(RooArgSet& allVars, RooArgSet& analVars, const char* /*rangeName*/=0) const {
+      if (matchArgs(allVars, analVars, x)) return 1;
+      return 0;
+    }
+
+    Double_t analyticalIntegral(Int_t /*code*/, const char* rangeName=0) const {
+      double umin = (x.min(rangeName)-mean)/sigma;
+      double umax = (x.max(rangeName)-mean)/sigma;
+      double A1  = TMath::Power(PNeg/TMath::Abs(ANeg),PNeg)*TMath::Exp(-ANeg*ANeg/2);
+      double A2  = TMath::Power(PPos/TMath::Abs(APos),PPos)*TMath::Exp(-APos*APos/2);
+      double B1  = PNeg/TMath::Abs(ANeg) - TMath::Abs(ANeg);
+      double B2  = PPos/TMath::Abs(APos) - TMath::Abs(APos);
+
+      double result = 0;
+      // tail below -ANeg: A1*(B1-u)^-PNeg
+      if (umin < -ANeg) result += A1*TailIntegral(B1-TMath::Min(umax,double(-ANeg)), B1-umin, PNeg);
+      // gaussian core
+      double lo = TMath::Max(umin,double(-ANeg));
+      double hi = TMath::Min(umax,double(APos));
+      if (lo < hi) result += TMath::Sqrt(TMath::PiOver2())*(TMath::Erf(hi/TMath::Sqrt2())-TMath::Erf(lo/TMath::Sqrt2()));
+      // tail above APos: A2*(B2+u)^-PPos
+      if (umax > APos) result += A2*TailIntegral(B2+TMath::Max(umin,double(APos)), B2+umax, PPos);
+      return sigma*result;
+    }
+
+  protected:
+    // integral of t^-n from t1 to t2
+    static double TailIntegral(double t1, double t2, double n) {
+      if (TMath::Abs(n-1) < 1e-12) return TMath::Log(t2/t1);
+      return (TMath::Power(t2,1-n)-TMath::Power(t1,1-n))/(1-n);
+    }
+
   private:
 
     ClassDef(RooDSCB,1) // Your description goes here...
@@ -8,6 +8,8 @@ Class to call the pol5-8 Czernecki et al parameterization for DIO tail (assumes
 #include "RooCategoryProxy.h"
 #include "RooAbsReal.h"
 #include "RooAbsCategory.h"
+#include <algorithm>
+#include <cmath>
 
 namespace rootfitter{
   class RooPol58 : public RooAbsPdf {
@@ -45,19 +47,48 @@ namespace rootfitter{
       RooRealProxy c8 ;
       
       Double_t evaluate() const {
+        return Shape(x);
+      }
+
+      double Shape(double xval) const {
         double muon_energy = 105.194;
         double atomic_mass = 26.981539*931.494095;
         double end_point = muon_energy - (muon_energy*muon_energy)/(2*atomic_mass);
         
-        if (x > end_point){
+        if (xval > end_point){
           return 0.0;
         }
         
-        double delta = muon_energy - x - (x*x)/(2*atomic_mass);
+        double delta = muon_energy - xval - (xval*xval)/(2*atomic_mass);
         double result = (c5*std::pow(delta, 5) + c6*std::pow(delta, 6) + c7*std::pow(delta, 7) + c8*std::pow(delta, 8));
         return result; 
       }
 
+    public:
+      // delta is quadratic in x, so below the end point the shape is a polynomial of degree 16
+      // in x and a 9-point Gauss-Legendre sum integrates it exactly
+      Int_t getAnalyticalIntegral(RooArgSet& allVars, RooArgSet& analVars, const char* /*rangeName*/=0) const {
+        if (matchArgs(allVars, analVars, x)) return 1;
+        return 0;
+      }
+
+      Double_t analyticalIntegral(Int_t /*code*/, const char* rangeName=0) const {
+        static const double nodes[9] = {-0.9681602395076261, -0.8360311073266358, -0.6133714327005904, -0.3242534234038089, 0.,
+                                        0.3242534234038089, 0.6133714327005904, 0.8360311073266358, 0.9681602395076261};
+        static const double weights[9] = {0.0812743883615744, 0.1806481606948574, 0.2606106964029354, 0.3123470770400029, 0.3302393550012598,
+                                          0.3123470770400029, 0.2606106964029354, 0.1806481606948574, 0.0812743883615744};
+        double muon_energy = 105.194;
+        double atomic_mass = 26.981539*931.494095;
+        double end_point = muon_energy - (muon_energy*muon_energy)/(2*atomic_mass);
+        double lo = x.min(rangeName);
+        double hi = std::min(double(x.max(rangeName)), end_point);
+        if (lo >= hi) return 0.0;
+        double half = (hi - lo)/2;
+        double mid = (hi + lo)/2;
+        double result = 0;
+        for (int i = 0; i < 9; ++i) result += weights[i]*Shape(mid + half*nodes[i]);
+        return half*result;
+      }
 
     private:
 
@@ -0,0 +1,65 @@
+#ifndef _RunReport_hh
+#define _RunReport_hh
+/*
+Lightweight per-stage instrumentation. Wrap a stage of the job in a ScopedStage and
+its wall/CPU time, peak RSS, bytes read and counters are added to the RunReport,
+which is written as JSON at the end of the job. When the report is not enabled a
+ScopedStage does nothing beyond one branch.
+*/
+#include <deque>
+#include <vector>
+#include <utility>
+#include "TString.h"
+
+namespace rootfitter{
+
+  struct StageRecord {
+    TString name;
+    int    ncalls = 0;
+    double wall_s = 0;
+    double cpu_s = 0;
+    long   peak_rss_kb = 0;
+    Long64_t bytes_read = 0;
+    Long64_t entries = 0;
+    Long64_t nll_calls = 0;
+    Long64_t minimizer_iterations = 0;
+  };
+
+  class RunReport {
+    public:
+      static RunReport& Instance();
+      void Enable(TString filename) { fFilename = filename; fEnabled = true; }
+      bool IsEnabled() const { return fEnabled; }
+      StageRecord& Stage(const TString& name);
+      void SetResult(const TString& name, double value);
+      void Write() const;
+    private:
+      RunReport() = default;
+      bool fEnabled = false;
+      TString fFilename;
+      std::deque<StageRecord> fStages; // deque keeps references held by open stages valid
+      std::vector<std::pair<TString, double> > fResults;
+  };
+
+  class ScopedStage {
+    public:
+      explicit ScopedStage(const char* name);
+      ~ScopedStage() { Stop(); }
+      ScopedStage(const ScopedStage &) = delete;
+      ScopedStage& operator = (const ScopedStage &) = delete;
+      void AddEntries(Long64_t n) { if(fRecord) fRecord->entries += n; }
+      void AddNLLCalls(Long64_t n) { if(fRecord) fRecord->nll_calls += n; }
+      void AddIterations(Long64_t n) { if(fRecord) fRecord->minimizer_iterations += n; }
+      void Stop();
+    private:
+      StageRecord* fRecord = 0;
+      double fWall0 = 0;
+      double fCpu0 = 0;
+      Long64_t fBytes0 = 0;
+  };
+
+  double WallSeconds();
+  double CpuSeconds();
+  long PeakRSSkB();
+}
+#endif /* RunReport.hh */
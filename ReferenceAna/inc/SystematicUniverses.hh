@@ -0,0 +1,56 @@
+#ifndef _SystematicUniverses_hh
+#define _SystematicUniverses_hh
+/*
+Systematic universes for the momentum fit. A lateral universe shifts or scales the
+reconstructed momentum; a vertical universe reweights candidates (optionally only
+those of one MC truth start code). One checkpointable pass over the ntuple keeps the
+candidates (and fills the MC truth counts), from which the CV dataset and a dataset per
+universe are built; the universes are then refitted in parallel worker processes
+(FitInParallel), each starting from the CV fit result.
+*/
+#include <vector>
+#include "TString.h"
+#include "TTree.h"
+#include "ReferenceAna/inc/FitResultStore.hh"
+
+namespace rootfitter{
+  class TruthCounts;
+  class LoopCheckpoint;
+
+  struct SystUniverse {
+    TString band;
+    double  nsigma = 0;
+    // lateral: p -> mom_scale*p + mom_shift
+    double  mom_scale = 1;
+    double  mom_shift = 0;
+    // vertical: w = 1 + nsigma*weight_per_sigma for candidates with this start code (0 = all)
+    double  weight_per_sigma = 0;
+    int     weight_start_code = 0;
+
+    TString Name() const { return Form("%s_%+gsigma", band.Data(), nsigma); }
+    double Momentum(double mom) const { return mom_scale*mom + mom_shift; }
+    double Weight(int start_code) const {
+      if(weight_start_code != 0 and start_code != weight_start_code) return 1;
+      return 1 + nsigma*weight_per_sigma;
+    }
+  };
+
+  // +-1 sigma momentum scale, momentum offset and DIO normalisation
+  std::vector<SystUniverse> DefaultUniverses();
+
+  struct SystematicsResult {
+    FitRecord cv;
+    std::vector<FitRecord> universes;
+    std::vector<TString> bands;
+    std::vector<std::vector<double> > band_cov; // per band, 3x3 over nsig, ndio, ncosmics
+    std::vector<double> band_rmue_shift;        // per band
+    double cov[9] = {0};                        // sum over bands
+  };
+
+  // truth, if given, is filled in the same pass over the ntuple; checkpoint, if given,
+  // resumes the pass from its last save and saves it periodically
+  SystematicsResult RunSystematics(TTree *trkana, bool usecuts, double mom_lo, double mom_hi,
+                                   const std::vector<SystUniverse> &universes, unsigned int n_threads,
+                                   TruthCounts *truth = 0, LoopCheckpoint *checkpoint = 0);
+}
+#endif /* SystematicUniverses.hh */
@@ -0,0 +1,75 @@
+#ifndef _TemplateMorphing_hh
+#define _TemplateMorphing_hh
+/*
+Momentum templates for nuisance parameters. For every component (CE, DIO) there is a
+nominal template and, per systematic, an up (+1 sigma) and a down (-1 sigma) template.
+They are built once, from the ntuple with the SystUniverses or read from a file
+(e.g. an MnvH1D's CV and +-1 sigma universes), and kept in memory. MorphingModel
+interpolates between them as a function of one Gaussian-constrained nuisance parameter
+per systematic, so the fit profiles the systematics without re-reading the data.
+
+A systematic whose up and down templates have the nominal shape (a pure normalisation,
+e.g. DIONorm) would do nothing inside a normalised shape with a free yield. It is
+applied to the yield instead: the fitted count is n x (1 + alpha x (up/nominal - 1)),
+linear in alpha (down/nominal for alpha < 0), while n, the yield parameter reported and
+used for Rmue, is the nominal-normalisation yield.
+
+File layout: <component>_nominal, <component>_<systematic>_up, <component>_<systematic>_down
+*/
+#include <memory>
+#include <vector>
+#include "TH1D.h"
+#include "TString.h"
+#include "TTree.h"
+#include "RooRealVar.h"
+#include "RooAddPdf.h"
+#include "RooArgSet.h"
+#include "RooArgList.h"
+#include "RooDataHist.h"
+#include "ReferenceAna/inc/SystematicUniverses.hh"
+
+namespace rootfitter{
+
+  struct ComponentTemplates {
+    TString name;       // CE or DIO
+    int start_code = 0; // MC truth start code when built from the ntuple
+    std::unique_ptr<TH1D> nominal;
+    std::vector<std::unique_ptr<TH1D> > up;   // one per systematic, in MomentumTemplates::systematics order
+    std::vector<std::unique_ptr<TH1D> > down;
+  };
+
+  struct MomentumTemplates {
+    std::vector<TString> systematics;
+    std::vector<ComponentTemplates> components;
+  };
+
+  // one pass over the ntuple; up/down are the +-1 sigma universes of each band
+  MomentumTemplates BuildMomentumTemplates(TTree *trkana, bool usecuts, double mom_lo, double mom_hi, int nbins,
+                                           const std::vector<SystUniverse> &universes);
+  MomentumTemplates ReadMomentumTemplates(TString filename);
+
+  class MorphingModel {
+    public:
+      MorphingModel(const MomentumTemplates &templates, double mom_lo, double mom_hi);
+      MorphingModel(const MorphingModel &) = delete;
+      MorphingModel& operator = (const MorphingModel &) = delete;
+      ~MorphingModel();
+
+      RooRealVar& Momentum() { return recomom; }
+      RooAddPdf& Pdf() { return *fitFun; }
+      const RooArgSet& Nuisances() const { return alphas; }
+      const RooArgSet& Constraints() const { return constraints; }
+      RooRealVar& Yield(TString name); // nsig, ndio, ncosmics, before any normalisation nuisance
+
+    private:
+      RooRealVar recomom;
+      RooArgSet alphas;
+      RooArgSet constraints;
+      RooArgList yields;
+      RooArgList coefficients; // yields x normalisation modifiers
+      std::vector<std::unique_ptr<RooDataHist> > hists;
+      std::vector<std::unique_ptr<RooAbsArg> > owned; // clients after their servers
+      std::unique_ptr<RooAddPdf> fitFun;
+  };
+}
+#endif /* TemplateMorphing.hh */
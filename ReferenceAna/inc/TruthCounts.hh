@@ -0,0 +1,65 @@
+#ifndef _TruthCounts_hh
+#define _TruthCounts_hh
+/*
+MC truth bookkeeping for the selection, filled in the same pass as the candidates. Each
+event is classified once by the start code of its primary (as in StatsTool-CutNCount's
+mctruth.py) and counted at every cut stage it passes; the momentum of its leading track
+fills per-origin efficiency histograms. The rejected/selected split at the last stage is
+the confusion matrix stored with the fit results.
+*/
+#include <memory>
+#include <vector>
+#include "TH1.h"
+#include "TH1D.h"
+#include "TDirectory.h"
+#include "ReferenceAna/inc/EventSelection.hh"
+#include "ReferenceAna/inc/FitResultStore.hh"
+
+namespace rootfitter{
+
+  class TruthCounts {
+    public:
+      TruthCounts(double mom_lo, double mom_hi, int nbins = 44);
+      TruthCounts(const TruthCounts &) = delete;
+      TruthCounts& operator = (const TruthCounts &) = delete;
+
+      // selection and truth for one event; candidate(fit) is called exactly as by ForEachCandidate
+      template <class F> void Fill(const TrkAnaEvent& event, bool usecuts, F&& candidate, int fitted = 0);
+
+      double Count(TruthOrigin origin, CutStage stage) const { return counts[origin][stage]; }
+      double Selected(TruthOrigin origin) const { return counts[origin][kNStages - 1]; }
+      double Rejected(TruthOrigin origin) const { return counts[origin][kStageAll] - Selected(origin); }
+      // mc_nce, mc_ndio, confusion and cutflow columns
+      void FillRecord(FitRecord &record) const;
+      void Print() const;
+      // per-origin passed/total/efficiency vs leading track momentum, confusion and cutflow
+      std::vector<std::unique_ptr<TH1> > Histograms() const;
+      // counters and histograms for a checkpoint, restored exactly
+      void Save(TDirectory *dir) const;
+      bool Restore(TDirectory *dir);
+
+      static const char *OriginName(int origin);
+      static const char *StageName(int stage);
+
+    private:
+      void Add(TruthOrigin origin, int stage, const mu2e::TrkFitInfo *leading);
+      double mom_lo;
+      double mom_hi;
+      double counts[kNOrigins][kNStages] = {{0}};
+      std::unique_ptr<TH1D> total[kNOrigins];  // events with a track
+      std::unique_ptr<TH1D> passed[kNOrigins]; // selected events
+  };
+
+  template <class F> void TruthCounts::Fill(const TrkAnaEvent& event, bool usecuts, F&& candidate, int fitted){
+    TruthOrigin origin = ClassifyTruth(event);
+    bool in_window = false;
+    ForEachCandidate(event, usecuts, [&](const mu2e::TrkFitInfo& fit){
+        double mom = fit.mom.R();
+        if(mom > mom_lo and mom < mom_hi) in_window = true;
+        candidate(fit);
+      }, fitted, [&](CutStage stage, const mu2e::TrkFitInfo *leading){
+        Add(origin, in_window ? kStageWindow : stage, leading);
+      });
+  }
+}
+#endif /* TruthCounts.hh */
@@ -0,0 +1,149 @@
+#include "ReferenceAna/inc/BatchConfig.hh"
+#include <iostream>
+#include <stdexcept>
+#include "cetlib/filepath_maker.h"
+#include "fhiclcpp/ParameterSet.h"
+using namespace rootfitter;
+
+bool rootfitter::ParseBool(TString value, bool& result){
+  value.ToLower();
+  if(value == "true" or value == "1" or value == "yes") { result = true; return true; }
+  if(value == "false" or value == "0" or value == "no") { result = false; return true; }
+  return false;
+}
+
+static ULong64_t FNV1a(const TString &key){
+  ULong64_t hash = 14695981039346656037ULL;
+  for (int i = 0; i < key.Length(); ++i){
+    hash ^= (unsigned char)key[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+ULong64_t FitJob::ConfigHash() const {
+  TString key = Form("%s|%s|%d|%s|%.17g|%.17g", filename.Data(), runname.Data(), int(usecuts), type.Data(), mom_lo, mom_hi);
+  if(type == "morph") key += Form("|%s|%d", templates.Data(), template_bins);
+  if(type == "multi") key += Form("|%d", observables);
+  if(type == "bootstrap") key += Form("|%u|%llu", replicas, seed);
+  if(type == "unbinned") key += Form("|gof%u|%llu", gof_toys, seed);
+  return FNV1a(key);
+}
+
+ULong64_t CombinedFit::ConfigHash() const {
+  TString key = "combined";
+  for (auto const& category : categories) key += Form("|%llu|%.17g", category.ConfigHash(), category.captures);
+  return FNV1a(key);
+}
+
+ULong64_t CampaignConfig::ConfigHash() const {
+  TString key = Form("campaign|%s|%u|%llu|%llu|%.17g|%.17g|%.17g", type.Data(), items, job.ConfigHash(), seed, nsig, ndio, ncosmics);
+  if(type == "scan") key += Form("|%.17g|%.17g", scan_lo, scan_hi);
+  for (auto const& file : files) key += "|" + file;
+  return FNV1a(key);
+}
+
+static FitJob ReadJob(const fhicl::ParameterSet &jobpset, TString default_name){
+  FitJob job;
+  job.name = jobpset.get<std::string>("name", default_name.Data());
+  job.filename = jobpset.get<std::string>("file");
+  job.runname = jobpset.get<std::string>("run");
+  job.usecuts = jobpset.get<bool>("usecuts", job.usecuts);
+  job.type = jobpset.get<std::string>("fit", job.type.Data());
+  job.mom_lo = jobpset.get<double>("mom_lo", job.mom_lo);
+  job.mom_hi = jobpset.get<double>("mom_hi", job.mom_hi);
+  job.threads = jobpset.get<unsigned int>("threads", job.threads);
+  job.templates = jobpset.get<std::string>("templates", job.templates.Data());
+  job.template_bins = jobpset.get<int>("template_bins", job.template_bins);
+  job.captures = jobpset.get<double>("captures", job.captures);
+  job.replicas = jobpset.get<unsigned int>("replicas", job.replicas);
+  job.seed = jobpset.get<unsigned long long>("seed", job.seed);
+  job.gof_toys = jobpset.get<unsigned int>("gof_toys", job.gof_toys);
+  std::vector<std::string> observables = jobpset.get<std::vector<std::string> >("observables", {"t0", "trkqual"});
+  job.observables = 0;
+  for (auto const& observable : observables){
+    if(observable == "t0") job.observables |= 1;
+    else if(observable == "trkqual") job.observables |= 2;
+    else throw std::runtime_error(Form("job %s: unknown observable %s, please select t0 or trkqual", job.name.Data(), observable.c_str()));
+  }
+  if(job.type != "binned" and job.type != "unbinned" and job.type != "systematics" and job.type != "morph" and job.type != "multi" and job.type != "bootstrap"){
+    throw std::runtime_error(Form("job %s: incorrect fit type %s, please select binned, unbinned, systematics, morph, multi or bootstrap", job.name.Data(), job.type.Data()));
+  }
+  return job;
+}
+
+BatchConfig rootfitter::ReadBatchConfig(TString filename){
+  cet::filepath_lookup_after1 policy("FHICL_FILE_PATH");
+  fhicl::ParameterSet pset = fhicl::ParameterSet::make(filename.Data(), policy);
+
+  BatchConfig config;
+  config.output = pset.get<std::string>("output", config.output.Data());
+  config.per_process = pset.get<bool>("per_process", config.per_process);
+  config.checkpoint = pset.get<std::string>("checkpoint", config.checkpoint.Data());
+  config.checkpoint_interval = pset.get<double>("checkpoint_interval", config.checkpoint_interval);
+  config.checkpoint_entries = pset.get<long long>("checkpoint_entries", config.checkpoint_entries);
+  config.plots = pset.get<bool>("plots", config.plots);
+  std::vector<fhicl::ParameterSet> empty;
+  for (auto const& jobpset : pset.get<std::vector<fhicl::ParameterSet> >("jobs", empty)){
+    config.jobs.push_back(ReadJob(jobpset, Form("job%lu", config.jobs.size())));
+  }
+  for (auto const& combinedpset : pset.get<std::vector<fhicl::ParameterSet> >("combined", empty)){
+    CombinedFit combined;
+    combined.name = combinedpset.get<std::string>("name", Form("combined%lu", config.combined.size()));
+    combined.threads = combinedpset.get<unsigned int>("threads", combined.threads);
+    for (auto const& jobpset : combinedpset.get<std::vector<fhicl::ParameterSet> >("categories")){
+      combined.categories.push_back(ReadJob(jobpset, Form("category%lu", combined.categories.size())));
+      const FitJob &category = combined.categories.back();
+      // one observable for all categories
+      if(category.mom_lo != combined.categories[0].mom_lo or category.mom_hi != combined.categories[0].mom_hi){
+        throw std::runtime_error(Form("combined fit %s: category %s has a different momentum window", combined.name.Data(), category.name.Data()));
+      }
+    }
+    config.combined.push_back(combined);
+  }
+  std::cout<<"Read "<<config.jobs.size()<<" jobs and "<<config.combined.size()<<" combined fits from "<<filename<<std::endl;
+  return config;
+}
+
+CampaignConfig rootfitter::ReadCampaignConfig(TString filename){
+  cet::filepath_lookup_after1 policy("FHICL_FILE_PATH");
+  fhicl::ParameterSet pset = fhicl::ParameterSet::make(filename.Data(), policy);
+
+  CampaignConfig config;
+  config.name = pset.get<std::string>("name", config.name.Data());
+  config.type = pset.get<std::string>("type", config.type.Data());
+  config.output = pset.get<std::string>("output", config.output.Data());
+  config.items = pset.get<unsigned int>("items", config.items);
+  config.shards = pset.get<unsigned int>("shards", config.shards);
+  config.workers = pset.get<unsigned int>("workers", config.workers);
+  config.retries = pset.get<unsigned int>("retries", config.retries);
+  config.seed = pset.get<unsigned long long>("seed", config.seed);
+  config.nsig = pset.get<double>("nsig", config.nsig);
+  config.ndio = pset.get<double>("ndio", config.ndio);
+  config.ncosmics = pset.get<double>("ncosmics", config.ncosmics);
+  config.scan_lo = pset.get<double>("scan_lo", config.scan_lo);
+  config.scan_hi = pset.get<double>("scan_hi", config.scan_hi);
+  config.checkpoint_interval = pset.get<double>("checkpoint_interval", config.checkpoint_interval);
+  FitJob &job = config.job;
+  job.name = config.name;
+  job.type = config.type;
+  job.filename = pset.get<std::string>("file", "");
+  job.runname = pset.get<std::string>("run", "");
+  job.usecuts = pset.get<bool>("usecuts", job.usecuts);
+  job.mom_lo = pset.get<double>("mom_lo", job.mom_lo);
+  job.mom_hi = pset.get<double>("mom_hi", job.mom_hi);
+  for (auto const& file : pset.get<std::vector<std::string> >("files", {})) config.files.push_back(file);
+
+  if(config.type != "toys" and config.type != "scan" and config.type != "universes" and config.type != "files"){
+    throw std::runtime_error(Form("campaign %s: incorrect type %s, please select toys, scan, universes or files", config.name.Data(), config.type.Data()));
+  }
+  if((config.type == "scan" or config.type == "universes") and job.filename == ""){
+    throw std::runtime_error(Form("campaign %s: a %s campaign needs a file", config.name.Data(), config.type.Data()));
+  }
+  if(config.type == "files" and config.files.empty()){
+    throw std::runtime_error(Form("campaign %s: a files campaign needs a list of files", config.name.Data()));
+  }
+  if(config.shards < 1 or config.workers < 1) throw std::runtime_error(Form("campaign %s: shards and workers must be at least 1", config.name.Data()));
+  std::cout<<"Read "<<config.type<<" campaign "<<config.name<<" ("<<config.shards<<" shards, "<<config.workers<<" workers) from "<<filename<<std::endl;
+  return config;
+}
@@ -0,0 +1,113 @@
+#include "ReferenceAna/inc/Bootstrap.hh"
+#include "ReferenceAna/inc/EventSelection.hh"
+#include "ReferenceAna/inc/TruthCounts.hh"
+#include "ReferenceAna/inc/Checkpoint.hh"
+#include "ReferenceAna/inc/FitModel.hh"
+#include "ReferenceAna/inc/RunReport.hh"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include "TTree.h"
+#include "RooDataSet.h"
+using namespace rootfitter;
+
+BootstrapResult rootfitter::RunBootstrap(TTree *trkana, bool usecuts, double mom_lo, double mom_hi,
+                                         unsigned int n_replicas, ULong64_t seed, unsigned int n_threads,
+                                         TruthCounts *truth, LoopCheckpoint *checkpoint){
+  std::cout<<" ------  bootstrap: one event pass, "<<n_replicas<<" replicas on "<<n_threads<<" processes ----- "<<std::endl;
+  BootstrapResult boot;
+
+  // one pass over the ntuple keeps the momentum and weight counter of every candidate in
+  // the window, the state the checkpoint saves
+  Double_t mom;
+  ULong64_t counter;
+  TTree candidates("boot_candidates", "selected candidates");
+  candidates.SetDirectory(0);
+  candidates.Branch("mom", &mom, "mom/D");
+  candidates.Branch("counter", &counter, "counter/l");
+  {
+    ScopedStage stage("BootstrapSelection");
+    TrkAnaEvent event;
+    event.SetBranchAddresses(trkana);
+    Long64_t n_events = trkana->GetEntries();
+    Long64_t first = checkpoint ? checkpoint->Restore(LoopInput(trkana, usecuts), 0, &candidates, truth) : 0;
+    for (Long64_t i_event = first; i_event < n_events; ++i_event) {
+      trkana->GetEntry(i_event);
+      ULong64_t i_candidate = 0;
+      auto candidate = [&](const mu2e::TrkFitInfo& fit){
+        counter = (ULong64_t(i_event) << 16) | i_candidate++;
+        mom = fit.mom.R();
+        if(mom > mom_lo and mom < mom_hi) candidates.Fill();
+      };
+      if(truth) truth->Fill(event, usecuts, candidate);
+      else ForEachCandidate(event, usecuts, candidate);
+      if(checkpoint) checkpoint->Update(i_event + 1, 0, &candidates, truth);
+    }
+    if(checkpoint and first < n_events) checkpoint->Save(n_events, 0, &candidates, truth);
+    stage.AddEntries(n_events - first);
+  }
+
+  // the nominal dataset and the replicas, in candidate order
+  RooRealVar recomom("recomom", "reco mom [MeV/c]", mom_lo, mom_hi);
+  RooRealVar weight("weight", "weight", 1);
+  RooDataSet nominal("nominal", "nominal", RooArgSet(recomom));
+  std::vector<std::unique_ptr<RooDataSet> > data;
+  for (unsigned int r = 0; r < n_replicas; ++r){
+    data.emplace_back(new RooDataSet(Form("replica%u", r), "", RooArgSet(recomom, weight), RooFit::WeightVar(weight)));
+  }
+  for (Long64_t i = 0; i < candidates.GetEntries(); ++i){
+    candidates.GetEntry(i);
+    recomom.setVal(mom);
+    nominal.add(RooArgSet(recomom));
+    for (unsigned int r = 0; r < n_replicas; ++r){
+      int w = PoissonOne(CounterUniform(seed, counter, r));
+      if(w > 0) data[r]->add(RooArgSet(recomom), w);
+    }
+  }
+
+  // nominal fit, then the replicas starting from it
+  ScopedStage stage("BootstrapFits");
+  FitModel model(mom_lo, mom_hi);
+  std::unique_ptr<RooFitResult> result(model.Fit(nominal, n_threads));
+  FillFitRecord(*result, boot.nominal);
+  boot.nominal.name = "nominal";
+  boot.nominal.rmue = model.Rmue();
+
+  std::vector<RooAbsData*> replica_data;
+  for (auto& d : data) replica_data.push_back(d.get());
+  FitInParallel(replica_data, &result->floatParsFinal(), mom_lo, mom_hi, n_threads, boot.replicas);
+  stage.Stop();
+
+  // spreads over the converged replicas
+  unsigned int n = 0;
+  double nsig2 = 0, ndio = 0, ndio2 = 0, rmue2 = 0;
+  for (unsigned int r = 0; r < boot.replicas.size(); ++r){
+    FitRecord &replica = boot.replicas[r];
+    replica.name = Form("replica%u", r);
+    if(replica.status != 0) continue;
+    ++n;
+    boot.nsig_mean += replica.nsig;
+    nsig2 += replica.nsig*replica.nsig;
+    ndio += replica.ndio;
+    ndio2 += replica.ndio*replica.ndio;
+    boot.rmue_mean += replica.rmue;
+    rmue2 += replica.rmue*replica.rmue;
+  }
+  if(n > 1){
+    boot.nsig_mean /= n;
+    boot.rmue_mean /= n;
+    ndio /= n;
+    boot.nsig_rms = std::sqrt(std::max(0., (nsig2/n - boot.nsig_mean*boot.nsig_mean)*n/(n - 1)));
+    boot.ndio_rms = std::sqrt(std::max(0., (ndio2/n - ndio*ndio)*n/(n - 1)));
+    boot.rmue_rms = std::sqrt(std::max(0., (rmue2/n - boot.rmue_mean*boot.rmue_mean)*n/(n - 1)));
+  }
+  std::cout<<"Bootstrap ("<<n<<" of "<<boot.replicas.size()<<" replicas converged): NSig = "<<boot.nominal.nsig<<" +- "<<boot.nsig_rms
+           <<" (fit error "<<boot.nominal.nsig_err<<"), NDIO +- "<<boot.ndio_rms<<", Rmue = "<<boot.nominal.rmue<<" +- "<<boot.rmue_rms<<std::endl;
+  RunReport& report = RunReport::Instance();
+  report.SetResult("bootstrap_replicas", n);
+  report.SetResult("bootstrap_nsig_rms", boot.nsig_rms);
+  report.SetResult("bootstrap_ndio_rms", boot.ndio_rms);
+  report.SetResult("bootstrap_rmue_rms", boot.rmue_rms);
+  return boot;
+}
@@ -0,0 +1,277 @@
+#include "ReferenceAna/inc/Campaign.hh"
+#include "ReferenceAna/inc/EventSelection.hh"
+#include "ReferenceAna/inc/FitModel.hh"
+#include "ReferenceAna/inc/FitResultStore.hh"
+#include "ReferenceAna/inc/RunReport.hh"
+#include "ReferenceAna/inc/SystematicUniverses.hh"
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "TSystem.h"
+#include "RooDataSet.h"
+#include "RooRandom.h"
+using namespace rootfitter;
+
+unsigned int rootfitter::CampaignItems(const CampaignConfig &config){
+  if(config.type == "universes") return DefaultUniverses().size();
+  if(config.type == "files") return config.files.size();
+  return config.items;
+}
+
+std::pair<unsigned int, unsigned int> rootfitter::ShardItems(unsigned int n_items, unsigned int n_shards, unsigned int shard){
+  ULong64_t first = ULong64_t(n_items)*shard/n_shards;
+  ULong64_t last = ULong64_t(n_items)*(shard + 1)/n_shards;
+  return std::make_pair(static_cast<unsigned int>(first), static_cast<unsigned int>(last));
+}
+
+TString rootfitter::ShardFilename(const CampaignConfig &config, unsigned int shard){
+  TString stem = config.output;
+  if(stem.EndsWith(".root")) stem.Remove(stem.Length() - 5);
+  return Form("%s.shard%u.root", stem.Data(), shard);
+}
+
+// more shards than items would leave shards empty
+static unsigned int NShards(const CampaignConfig &config){
+  return std::max(1u, std::min(config.shards, CampaignItems(config)));
+}
+
+static TString ItemName(const CampaignConfig &config, unsigned int item){
+  return Form("%s/%06u", config.name.Data(), item);
+}
+
+// the item number runs from after "<name>/" to the next '/' (universes) or the end; it is
+// zero-padded to 6 digits but longer for campaigns of a million items or more
+static unsigned int ItemFromName(const CampaignConfig &config, const TString &name){
+  Ssiz_t start = config.name.Length() + 1;
+  Ssiz_t end = name.Index("/", start);
+  if(end == kNPOS) end = name.Length();
+  TString item = name(start, end - start);
+  return item.Atoi();
+}
+
+// candidates in the fit window, on the model's momentum
+static std::unique_ptr<RooDataSet> SelectMomenta(TTree *trkana, bool usecuts, RooRealVar &recomom){
+  ScopedStage stage("Selection");
+  std::unique_ptr<RooDataSet> data(new RooDataSet("campaign_data", "selected candidates", RooArgSet(recomom)));
+  TrkAnaEvent event;
+  event.SetBranchAddresses(trkana);
+  Long64_t n_events = trkana->GetEntries();
+  for (Long64_t i_event = 0; i_event < n_events; ++i_event) {
+    trkana->GetEntry(i_event);
+    ForEachCandidate(event, usecuts, [&](const mu2e::TrkFitInfo& fit){
+      double mom = fit.mom.R();
+      if(mom > recomom.getMin() and mom < recomom.getMax()){
+        recomom.setVal(mom);
+        data->add(RooArgSet(recomom));
+      }
+    });
+  }
+  stage.AddEntries(n_events);
+  return data;
+}
+
+static void FitToy(const CampaignConfig &config, unsigned int item, FitModel &model, FitRecord &record){
+  model.Reset();
+  model.NSig().setVal(config.nsig);
+  model.NDIO().setVal(config.ndio);
+  model.NCosmics().setVal(config.ncosmics);
+  // TRandom3 treats seed 0 as "random"
+  RooRandom::randomGenerator()->SetSeed(ULong_t(ItemSeed(config.seed, item) % 4294967295ULL) + 1);
+  std::unique_ptr<RooDataSet> toy(model.Pdf().generate(RooArgSet(model.Momentum()), RooFit::Extended()));
+  model.Reset();
+  FitAndRecord(model, *toy, record);
+}
+
+static void FitScanPoint(const CampaignConfig &config, unsigned int item, FitModel &model, RooDataSet &data, FitRecord &record){
+  unsigned int n_points = CampaignItems(config);
+  double nsig = n_points > 1 ? config.scan_lo + item*(config.scan_hi - config.scan_lo)/(n_points - 1) : config.scan_lo;
+  model.Reset();
+  model.NSig().setVal(nsig);
+  model.NSig().setConstant(true);
+  FitAndRecord(model, data, record);
+  model.NSig().setConstant(false);
+  record.nsig = nsig; // fixed, so not among the fitted parameters
+  record.nsig_err = 0;
+}
+
+int rootfitter::RunCampaignShard(const CampaignConfig &config, unsigned int shard, std::function<TTree*(TString)> open){
+  unsigned int n_items = CampaignItems(config);
+  unsigned int n_shards = NShards(config);
+  if(shard >= n_shards){
+    std::cout<<"campaign "<<config.name<<" has "<<n_shards<<" shards, no shard "<<shard<<std::endl;
+    return 1;
+  }
+  std::pair<unsigned int, unsigned int> items = ShardItems(n_items, n_shards, shard);
+  std::cout<<"----------------Campaign "<<config.name<<" shard "<<shard<<": "<<config.type<<" items "<<items.first<<" to "<<items.second - 1<<" ------------"<<std::endl;
+  TString filename = ShardFilename(config, shard);
+  ULong64_t config_hash = config.ConfigHash();
+  // a rerun shard skips the items an earlier attempt stored; the store is flushed every checkpoint_interval s
+  std::set<unsigned int> done;
+  std::vector<FitRecord> stored;
+  bool resumable = FitResultStore::Read(filename, stored);
+  for (auto const& record : stored){
+    if(record.config_hash != config_hash) resumable = false;
+    done.insert(ItemFromName(config, record.name));
+  }
+  // universes are fitted together with their CV, so only a complete shard counts
+  if(config.type == "universes" and done.size() < items.second - items.first) resumable = false;
+  if(!resumable){
+    done.clear();
+    gSystem->Unlink(filename);
+  } else {
+    std::cout<<"campaign "<<config.name<<" shard "<<shard<<": "<<done.size()<<" items already in "<<filename<<std::endl;
+  }
+  FitResultStore store(filename);
+  const FitJob &job = config.job;
+  auto append = [&](FitRecord record, unsigned int item){
+    record.name = ItemName(config, item) + (record.name == "" ? "" : "/" + record.name);
+    record.config_hash = config_hash;
+    store.Append(record);
+  };
+
+  if(config.type == "universes"){
+    if(!done.empty()){
+      store.Close();
+      return 0;
+    }
+    std::vector<SystUniverse> universes = DefaultUniverses();
+    std::vector<SystUniverse> shard_universes(universes.begin() + items.first, universes.begin() + items.second);
+    SystematicsResult syst = RunSystematics(open(job.filename), job.usecuts, job.mom_lo, job.mom_hi, shard_universes, 1);
+    for (unsigned int u = 0; u < syst.universes.size(); ++u) append(syst.universes[u], items.first + u);
+    store.Close();
+    return 0;
+  }
+
+  FitModel model(job.mom_lo, job.mom_hi);
+  std::unique_ptr<RooDataSet> data;
+  if(config.type == "scan" and done.size() < items.second - items.first) data = SelectMomenta(open(job.filename), job.usecuts, model.Momentum());
+  double last_flush = WallSeconds();
+  for (unsigned int item = items.first; item < items.second; ++item){
+    if(done.count(item)) continue;
+    FitRecord record;
+    if(config.type == "toys"){
+      FitToy(config, item, model, record);
+    } else if(config.type == "scan"){
+      FitScanPoint(config, item, model, *data, record);
+    } else {
+      std::unique_ptr<RooDataSet> file_data = SelectMomenta(open(config.files[item]), job.usecuts, model.Momentum());
+      model.Reset();
+      FitAndRecord(model, *file_data, record);
+    }
+    append(record, item);
+    if(WallSeconds() - last_flush >= config.checkpoint_interval){
+      store.Flush();
+      last_flush = WallSeconds();
+    }
+  }
+  store.Close();
+  return 0;
+}
+
+// forks `executable --campaign-shard configname shard`, output to the shard's log file
+static pid_t LaunchShard(TString executable, TString configname, const CampaignConfig &config, unsigned int shard){
+  TString log = ShardFilename(config, shard);
+  log.ReplaceAll(".root", ".log");
+  TString shard_arg = Form("%u", shard);
+  pid_t pid = fork();
+  if(pid != 0) return pid; // parent, or -1 if fork failed
+  int fd = ::open(log.Data(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(fd >= 0){
+    dup2(fd, 1);
+    dup2(fd, 2);
+    close(fd);
+  }
+  const char *argv[] = {executable.Data(), "--campaign-shard", configname.Data(), shard_arg.Data(), 0};
+  execvp(argv[0], const_cast<char* const*>(argv));
+  _exit(127);
+}
+
+int rootfitter::RunCampaign(TString configname, TString executable){
+  CampaignConfig config = ReadCampaignConfig(configname);
+  unsigned int n_shards = NShards(config);
+  std::cout<<"----------------Campaign "<<config.name<<": "<<CampaignItems(config)<<" "<<config.type<<" items in "<<n_shards<<" shards, "<<config.workers<<" at a time ------------"<<std::endl;
+  std::deque<unsigned int> pending;
+  for (unsigned int shard = 0; shard < n_shards; ++shard) pending.push_back(shard);
+  std::vector<unsigned int> attempts(n_shards, 0);
+  std::map<pid_t, unsigned int> running;
+  bool failed = false;
+  while(!pending.empty() or !running.empty()){
+    while(!pending.empty() and running.size() < config.workers){
+      unsigned int shard = pending.front();
+      pending.pop_front();
+      ++attempts[shard];
+      pid_t pid = LaunchShard(executable, configname, config, shard);
+      if(pid < 0){
+        std::cout<<"campaign "<<config.name<<": cannot start shard "<<shard<<std::endl;
+        failed = true;
+        continue;
+      }
+      running[pid] = shard;
+    }
+    if(running.empty()) break;
+    int status = 0;
+    pid_t pid = waitpid(-1, &status, 0);
+    if(pid < 0) break;
+    auto it = running.find(pid);
+    if(it == running.end()) continue;
+    unsigned int shard = it->second;
+    running.erase(it);
+    if(WIFEXITED(status) and WEXITSTATUS(status) == 0){
+      std::cout<<"campaign "<<config.name<<": shard "<<shard<<" done"<<std::endl;
+      continue;
+    }
+    if(WIFSIGNALED(status)) std::cout<<"campaign "<<config.name<<": shard "<<shard<<" killed by signal "<<WTERMSIG(status);
+    else std::cout<<"campaign "<<config.name<<": shard "<<shard<<" exited with "<<WEXITSTATUS(status);
+    if(attempts[shard] <= config.retries){
+      std::cout<<", retrying ("<<attempts[shard]<<"/"<<config.retries<<")"<<std::endl;
+      pending.push_back(shard);
+    } else {
+      std::cout<<", giving up"<<std::endl;
+      failed = true;
+    }
+  }
+  if(failed){
+    std::cout<<"campaign "<<config.name<<" incomplete, not merged"<<std::endl;
+    return 1;
+  }
+  return MergeCampaign(config) ? 0 : 1;
+}
+
+bool rootfitter::MergeCampaign(const CampaignConfig &config){
+  unsigned int n_items = CampaignItems(config);
+  unsigned int n_shards = NShards(config);
+  std::vector<FitRecord> records;
+  for (unsigned int shard = 0; shard < n_shards; ++shard){
+    if(!FitResultStore::Read(ShardFilename(config, shard), records)){
+      std::cout<<"campaign "<<config.name<<": cannot read "<<ShardFilename(config, shard)<<std::endl;
+      return false;
+    }
+  }
+  std::vector<bool> seen(n_items, false);
+  for (auto& record : records){
+    unsigned int item = ItemFromName(config, record.name);
+    if(item < n_items) seen[item] = true;
+    record.fit_wall_s = 0;
+    record.fit_cpu_s = 0;
+  }
+  unsigned int n_missing = std::count(seen.begin(), seen.end(), false);
+  if(n_missing > 0){
+    std::cout<<"campaign "<<config.name<<": "<<n_missing<<" items missing, not merged"<<std::endl;
+    return false;
+  }
+  std::stable_sort(records.begin(), records.end(), [&](const FitRecord &a, const FitRecord &b){
+    return ItemFromName(config, a.name) < ItemFromName(config, b.name);
+  });
+  gSystem->Unlink(config.output);
+  FitResultStore store(config.output);
+  for (auto const& record : records) store.Append(record);
+  store.Close();
+  std::cout<<"campaign "<<config.name<<": "<<records.size()<<" results from "<<n_shards<<" shards merged into "<<config.output<<std::endl;
+  return true;
+}
@@ -0,0 +1,83 @@
+#include "ReferenceAna/inc/Checkpoint.hh"
+#include "ReferenceAna/inc/RunReport.hh"
+#include <iostream>
+#include <memory>
+#include "TFile.h"
+#include "TNamed.h"
+#include "TParameter.h"
+#include "TSystem.h"
+using namespace rootfitter;
+
+TString rootfitter::LoopInput(TTree *trkana, bool usecuts, int fitted){
+  TFile *file = trkana->GetCurrentFile();
+  return Form("%s|%lld|%d|%d", file ? file->GetName() : trkana->GetName(), trkana->GetEntries(), int(usecuts), fitted);
+}
+
+LoopCheckpoint::LoopCheckpoint(TString filename, double interval_s, Long64_t check_every) :
+  filename(filename),
+  interval_s(interval_s),
+  check_every(check_every > 0 ? check_every : 1),
+  last_save(WallSeconds())
+{}
+
+bool LoopCheckpoint::Due() const {
+  return WallSeconds() - last_save >= interval_s;
+}
+
+Long64_t LoopCheckpoint::Restore(TString input_id, TH1 *hist, TTree *tree, TruthCounts *truth){
+  input = input_id;
+  last_save = WallSeconds();
+  if(!Enabled() or gSystem->AccessPathName(filename)) return 0; // no checkpoint yet
+  TDirectory::TContext context;
+  std::unique_ptr<TFile> file(TFile::Open(filename));
+  if(!file or file->IsZombie()) return 0;
+  TNamed *saved_input = static_cast<TNamed*>(file->Get("input"));
+  TParameter<Long64_t> *done = static_cast<TParameter<Long64_t>*>(file->Get("entries_done"));
+  TH1 *saved_hist = hist ? static_cast<TH1*>(file->Get("hist")) : 0;
+  TTree *saved_tree = tree ? static_cast<TTree*>(file->Get("tree")) : 0;
+  if(!saved_input or !done or input != saved_input->GetTitle() or (hist and !saved_hist) or (tree and !saved_tree)){
+    std::cout<<"Checkpoint "<<filename<<" is for another input, starting from entry 0"<<std::endl;
+    return 0;
+  }
+  if(truth and !truth->Restore(file.get())){
+    std::cout<<"Checkpoint "<<filename<<" has no truth counts, starting from entry 0"<<std::endl;
+    return 0;
+  }
+  if(hist){
+    hist->Reset();
+    hist->Add(saved_hist);
+  }
+  if(tree) tree->CopyEntries(saved_tree);
+  std::cout<<"Resuming from checkpoint "<<filename<<" at entry "<<done->GetVal()<<std::endl;
+  return done->GetVal();
+}
+
+void LoopCheckpoint::Save(Long64_t entries_done, const TH1 *hist, TTree *tree, const TruthCounts *truth){
+  if(!Enabled()) return;
+  ScopedStage stage("Checkpoint");
+  TString tmp = filename + ".tmp";
+  {
+    TDirectory::TContext context;
+    TFile file(tmp, "RECREATE");
+    TNamed saved_input("input", input.Data());
+    TParameter<Long64_t> done("entries_done", entries_done);
+    file.WriteTObject(&saved_input);
+    file.WriteTObject(&done);
+    if(hist) file.WriteTObject(hist, "hist");
+    if(tree){
+      file.cd();
+      TTree *copy = tree->CloneTree(-1);
+      copy->Write("tree");
+      delete copy;
+    }
+    if(truth) truth->Save(&file);
+    file.Close();
+  }
+  // the previous checkpoint is replaced only by a complete one
+  if(gSystem->Rename(tmp, filename) != 0) std::cout<<"Checkpoint: cannot rename "<<tmp<<" to "<<filename<<std::endl;
+  last_save = WallSeconds();
+}
+
+void LoopCheckpoint::Remove(){
+  if(Enabled()) gSystem->Unlink(filename);
+}
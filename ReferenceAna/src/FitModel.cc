@@ -0,0 +1,139 @@
+#include "ReferenceAna/inc/FitModel.hh"
+#include "ReferenceAna/inc/Likelihood.hh"
+#include "ReferenceAna/inc/RunReport.hh"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "TSystem.h"
+using namespace rootfitter;
+
+FitModel::FitModel(double mom_lo, double mom_hi) :
+  recomom("recomom", "reco mom [MeV/c]", mom_lo, mom_hi),
+  mean("mean", "mean", 104, 103, 105),
+  sigma("sigma", "sigma", 2.67104e-01, 0.1, 1.0),
+  ANeg("ANeg", "ANeg", 4.2e-01, 3e-01, 5e-01),
+  PNeg("PNeg", "PNeg", 2.51002e+01, 20,30),
+  APos("APos", "APos", 2.22666e+00, 2,3),
+  PPos("PPos", "PPos", 5.95360,5,7),
+  a5("a5", "a5", 8.6434e-17, 8.5e-17, 8.7e-17),
+  a6("a6", "a6", 1.16874e-17, 1.1e-17, 1.2e-17),
+  a7("a7", "a7", -1.87828e-19, -1.9e-19, -1.8e-19),
+  a8("a8", "a8", 9.16327e-20, 9.1e-20, 9.2e-20),
+  nsig("nsig", "number of signal events", 0.0, 0.0, 100),
+  ndio("ndio", "number in dio region", 0.0, 0.0, 100000),
+  ncosmics("ncosmics", "number of cosmics", 0.0, 0.0, 10),
+  Sig("Sig", "signal peak", recomom, mean, sigma, ANeg, PNeg, APos, PPos),
+  DIO("DIO", "dio tail", recomom, a5, a6, a7, a8),
+  Cosmic("Cosmic", "cosmic", recomom),
+  fitFun("fitFun", "Sig + DIO + Cosmic ", RooArgList(Sig, DIO, Cosmic), RooArgList(nsig, ndio, ncosmics)),
+  params(mean, sigma, ANeg, PNeg, APos, PPos)
+{
+  params.add(RooArgSet(a5, a6, a7, a8));
+  params.add(RooArgSet(nsig, ndio, ncosmics));
+  params.snapshot(initial);
+}
+
+void FitModel::Reset(){
+  params.assign(initial);
+  // migrad takes its initial step sizes from the errors, which assign() leaves at the last fit's
+  for (auto *arg : params){
+    RooRealVar *par = static_cast<RooRealVar*>(arg);
+    const RooRealVar *value = static_cast<const RooRealVar*>(initial.find(par->GetName()));
+    par->setError(value->getError());
+    par->removeAsymError();
+  }
+}
+
+double FitModel::Rmue() const {
+  return Likelihood::ReturnRmu(nsig, ndio);
+}
+
+void FitModel::SetParameters(const RooArgList &values){
+  for (auto *value : values){
+    RooRealVar *par = dynamic_cast<RooRealVar*>(params.find(value->GetName()));
+    RooAbsReal *val = dynamic_cast<RooAbsReal*>(value);
+    if(par and val) par->setVal(val->getVal());
+  }
+}
+
+RooFitResult *FitModel::Fit(RooAbsData &data, unsigned int n_cpu){
+  n_cpu = std::min(n_cpu, (unsigned int)(data.numEntries()/kMinEntriesPerCpu));
+  std::unique_ptr<RooAbsReal> nll(n_cpu > 1 ? fitFun.createNLL(data, RooFit::NumCPU(n_cpu)) : fitFun.createNLL(data, RooFit::CloneData(false)));
+  RooMinimizer m(*nll);
+  m.setPrintLevel(-1);
+  m.migrad();
+  m.hesse();
+  return m.save();
+}
+
+void rootfitter::FitAndRecord(FitModel &model, RooAbsData &data, FitRecord &record, unsigned int n_cpu){
+  double wall0 = WallSeconds();
+  double cpu0 = CpuSeconds();
+  std::unique_ptr<RooFitResult> result(model.Fit(data, n_cpu));
+  record.fit_wall_s = WallSeconds() - wall0;
+  record.fit_cpu_s = CpuSeconds() - cpu0;
+  FillFitRecord(*result, record);
+  record.rmue = model.Rmue();
+}
+
+void rootfitter::FitInProcesses(unsigned int n_items, unsigned int n_workers,
+                                const std::function<void(unsigned int, FitRecord&)> &fit, std::vector<FitRecord> &records){
+  records.assign(n_items, FitRecord());
+  n_workers = std::min(std::max(1u, n_workers), n_items);
+  if(n_workers <= 1){
+    for (unsigned int i = 0; i < n_items; ++i) fit(i, records[i]);
+    return;
+  }
+  auto first_item = [&](unsigned int worker){ return (unsigned int)((ULong64_t(n_items)*worker)/n_workers); };
+  std::vector<pid_t> pids(n_workers, -1);
+  std::vector<TString> files(n_workers);
+  std::cout.flush();
+  fflush(stdout);
+  for (unsigned int w = 0; w < n_workers; ++w){
+    files[w] = Form("%s/ReferenceAnaFits.%d.%u.root", gSystem->TempDirectory(), gSystem->GetPid(), w);
+    gSystem->Unlink(files[w]);
+    pids[w] = fork();
+    if(pids[w] == 0){
+      // worker: fit the block, return the records, and leave without running the parent's destructors
+      {
+        FitResultStore store(files[w]);
+        for (unsigned int i = first_item(w); i < first_item(w + 1); ++i){
+          fit(i, records[i]);
+          store.Append(records[i]);
+        }
+        store.Close();
+      }
+      _exit(0);
+    }
+  }
+  for (unsigned int w = 0; w < n_workers; ++w){
+    std::vector<FitRecord> done;
+    if(pids[w] > 0){
+      int status = 0;
+      waitpid(pids[w], &status, 0);
+      FitResultStore::Read(files[w], done);
+      gSystem->Unlink(files[w]);
+    }
+    // the rows are in item order, so a worker that died returned the start of its block
+    unsigned int first = first_item(w);
+    for (unsigned int i = first; i < first_item(w + 1); ++i){
+      if(i - first < done.size()) records[i] = done[i - first];
+      else fit(i, records[i]);
+    }
+    if(done.size() < first_item(w + 1) - first) std::cout<<"FitInProcesses: worker "<<w<<" returned "<<done.size()<<" of "<<first_item(w + 1) - first<<" fits, the rest were refitted here"<<std::endl;
+  }
+}
+
+void rootfitter::FitInParallel(const std::vector<RooAbsData*> &data, const RooArgList *start, double mom_lo, double mom_hi,
+                               unsigned int n_workers, std::vector<FitRecord> &records){
+  std::unique_ptr<FitModel> model; // one per process, built on its first fit
+  FitInProcesses(data.size(), n_workers, [&](unsigned int i, FitRecord &record){
+      if(!model) model.reset(new FitModel(mom_lo, mom_hi));
+      model->Reset();
+      if(start) model->SetParameters(*start);
+      FitAndRecord(*model, *data[i], record);
+    }, records);
+}
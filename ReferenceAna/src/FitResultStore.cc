@@ -0,0 +1,178 @@
+#include "ReferenceAna/inc/FitResultStore.hh"
+#include <iostream>
+#include <memory>
+#include "TDirectory.h"
+#include "TFileMerger.h"
+#include "TMatrixDSym.h"
+#include "TSystem.h"
+#include "RooRealVar.h"
+using namespace rootfitter;
+
+void rootfitter::FillFitRecord(const RooFitResult &result, FitRecord &record){
+  record.status = result.status();
+  record.covqual = result.covQual();
+  record.edm = result.edm();
+  record.minnll = result.minNll();
+  const RooArgList &pars = result.floatParsFinal();
+  const char *yields[3] = {"nsig", "ndio", "ncosmics"};
+  double *values[3] = {&record.nsig, &record.ndio, &record.ncosmics};
+  double *errors[3] = {&record.nsig_err, &record.ndio_err, &record.ncosmics_err};
+  int index[3];
+  for (int i = 0; i < 3; ++i){
+    index[i] = pars.index(yields[i]);
+    if(index[i] < 0) continue;
+    RooRealVar *var = static_cast<RooRealVar*>(pars.at(index[i]));
+    *values[i] = var->getVal();
+    *errors[i] = var->getError();
+  }
+  if(result.covQual() < 0) return; // no covariance, e.g. hesse not run
+  const TMatrixDSym &cov = result.covarianceMatrix();
+  for (int i = 0; i < 3; ++i){
+    for (int j = 0; j < 3; ++j){
+      record.cov[3*i + j] = (index[i] < 0 or index[j] < 0) ? 0 : cov(index[i], index[j]);
+    }
+  }
+}
+
+// branch addresses of an existing fits tree; name_ptr must outlive the reads
+static void SetRowAddresses(TTree *tree, FitRecord &row, TString *&name_ptr){
+  name_ptr = &row.name;
+  tree->SetBranchAddress("name", &name_ptr);
+  tree->SetBranchAddress("config_hash", &row.config_hash);
+  tree->SetBranchAddress("nsig", &row.nsig);
+  tree->SetBranchAddress("ndio", &row.ndio);
+  tree->SetBranchAddress("ncosmics", &row.ncosmics);
+  tree->SetBranchAddress("nsig_err", &row.nsig_err);
+  tree->SetBranchAddress("ndio_err", &row.ndio_err);
+  tree->SetBranchAddress("ncosmics_err", &row.ncosmics_err);
+  tree->SetBranchAddress("cov", row.cov);
+  tree->SetBranchAddress("rmue", &row.rmue);
+  tree->SetBranchAddress("status", &row.status);
+  tree->SetBranchAddress("covqual", &row.covqual);
+  tree->SetBranchAddress("edm", &row.edm);
+  tree->SetBranchAddress("minnll", &row.minnll);
+  tree->SetBranchAddress("fit_wall_s", &row.fit_wall_s);
+  tree->SetBranchAddress("fit_cpu_s", &row.fit_cpu_s);
+  tree->SetBranchAddress("mc_nce", &row.mc_nce);
+  tree->SetBranchAddress("mc_ndio", &row.mc_ndio);
+  tree->SetBranchAddress("confusion", row.confusion);
+  tree->SetBranchAddress("cutflow", row.cutflow);
+  tree->SetBranchAddress("ks", &row.ks);
+  tree->SetBranchAddress("ad", &row.ad);
+  tree->SetBranchAddress("ks_pvalue", &row.ks_pvalue);
+  tree->SetBranchAddress("ad_pvalue", &row.ad_pvalue);
+}
+
+FitResultStore::FitResultStore(TString filename, bool per_process) : fFilename(filename) {
+  if(per_process){
+    TString stem = filename;
+    if(stem.EndsWith(".root")) stem.Remove(stem.Length() - 5);
+    fFilename = Form("%s.%s.%d.root", stem.Data(), gSystem->HostName(), gSystem->GetPid());
+  }
+  TDirectory::TContext context; // leave the caller's current directory alone
+  fFile = TFile::Open(fFilename, "UPDATE");
+  if(!fFile or fFile->IsZombie()){
+    std::cout<<"FitResultStore: cannot open "<<fFilename<<std::endl;
+    delete fFile;
+    fFile = 0;
+    return;
+  }
+  fTree = static_cast<TTree*>(fFile->Get("fits"));
+  if(fTree){
+    // appending to an existing store
+    SetRowAddresses(fTree, fRow, fNamePtr);
+    return;
+  }
+  fFile->cd();
+  fTree = new TTree("fits", "ReferenceAna fit results");
+  fTree->Branch("name", &fRow.name);
+  fTree->Branch("config_hash", &fRow.config_hash, "config_hash/l");
+  fTree->Branch("nsig", &fRow.nsig, "nsig/D");
+  fTree->Branch("ndio", &fRow.ndio, "ndio/D");
+  fTree->Branch("ncosmics", &fRow.ncosmics, "ncosmics/D");
+  fTree->Branch("nsig_err", &fRow.nsig_err, "nsig_err/D");
+  fTree->Branch("ndio_err", &fRow.ndio_err, "ndio_err/D");
+  fTree->Branch("ncosmics_err", &fRow.ncosmics_err, "ncosmics_err/D");
+  fTree->Branch("cov", fRow.cov, "cov[9]/D");
+  fTree->Branch("rmue", &fRow.rmue, "rmue/D");
+  fTree->Branch("status", &fRow.status, "status/I");
+  fTree->Branch("covqual", &fRow.covqual, "covqual/I");
+  fTree->Branch("edm", &fRow.edm, "edm/D");
+  fTree->Branch("minnll", &fRow.minnll, "minnll/D");
+  fTree->Branch("fit_wall_s", &fRow.fit_wall_s, "fit_wall_s/D");
+  fTree->Branch("fit_cpu_s", &fRow.fit_cpu_s, "fit_cpu_s/D");
+  fTree->Branch("mc_nce", &fRow.mc_nce, "mc_nce/D");
+  fTree->Branch("mc_ndio", &fRow.mc_ndio, "mc_ndio/D");
+  fTree->Branch("confusion", fRow.confusion, Form("confusion[%d]/D", kNOrigins*2));
+  fTree->Branch("cutflow", fRow.cutflow, Form("cutflow[%d]/D", kNOrigins*kNStages));
+  fTree->Branch("ks", &fRow.ks, "ks/D");
+  fTree->Branch("ad", &fRow.ad, "ad/D");
+  fTree->Branch("ks_pvalue", &fRow.ks_pvalue, "ks_pvalue/D");
+  fTree->Branch("ad_pvalue", &fRow.ad_pvalue, "ad_pvalue/D");
+}
+
+void FitResultStore::Append(const FitRecord &record){
+  std::lock_guard<std::mutex> lock(fMutex);
+  if(!fTree) return;
+  fRow = record;
+  fTree->Fill();
+  // keep the rows on disk if the job dies
+  if(++fNSinceSave >= 100){
+    fTree->AutoSave("SaveSelf");
+    fNSinceSave = 0;
+  }
+}
+
+void FitResultStore::Flush(){
+  std::lock_guard<std::mutex> lock(fMutex);
+  if(!fTree) return;
+  TDirectory::TContext context;
+  fFile->cd();
+  fTree->AutoSave("SaveSelf");
+  fNSinceSave = 0;
+}
+
+void FitResultStore::WriteObject(const TObject &object, TString dirname){
+  std::lock_guard<std::mutex> lock(fMutex);
+  if(!fFile) return;
+  TDirectory::TContext context;
+  TDirectory *dir = fFile->mkdir(dirname, "", true);
+  if(dir) dir->WriteTObject(&object, object.GetName(), "Overwrite");
+}
+
+void FitResultStore::Close(){
+  std::lock_guard<std::mutex> lock(fMutex);
+  if(!fFile) return;
+  TDirectory::TContext context;
+  fFile->cd();
+  fTree->Write("", TObject::kOverwrite);
+  fFile->Close();
+  delete fFile;
+  fFile = 0;
+  fTree = 0;
+}
+
+bool FitResultStore::Read(TString filename, std::vector<FitRecord> &records){
+  TDirectory::TContext context;
+  std::unique_ptr<TFile> file(TFile::Open(filename));
+  TTree *tree = file ? static_cast<TTree*>(file->Get("fits")) : 0;
+  if(!tree) return false;
+  FitRecord row;
+  TString *name_ptr = 0;
+  SetRowAddresses(tree, row, name_ptr);
+  for (Long64_t i = 0; i < tree->GetEntries(); ++i){
+    tree->GetEntry(i);
+    records.push_back(row);
+  }
+  return true;
+}
+
+bool FitResultStore::Merge(const std::vector<TString> &shards, TString output){
+  TFileMerger merger(kFALSE);
+  merger.SetFastMethod(kTRUE);
+  if(!merger.OutputFile(output, "RECREATE")) return false;
+  for (auto const& shard : shards){
+    if(!merger.AddFile(shard)) return false;
+  }
+  return merger.Merge();
+}
@@ -0,0 +1,141 @@
+#include "ReferenceAna/inc/GoodnessOfFit.hh"
+#include "ReferenceAna/inc/Bootstrap.hh"
+#include "ReferenceAna/inc/RunReport.hh"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include "Math/ProbFuncMathCore.h"
+#include "RooDataSet.h"
+using namespace rootfitter;
+
+TabulatedCdf::TabulatedCdf(RooAbsPdf &pdf, RooRealVar &x, int n_points) :
+  lo(x.getMin()),
+  step((x.getMax() - x.getMin())/n_points),
+  cdf(n_points + 1, 0.)
+{
+  double x0 = x.getVal();
+  RooArgSet nset(x);
+  double previous = 0;
+  for (int i = 0; i <= n_points; ++i){
+    x.setVal(std::min(lo + i*step, x.getMax()));
+    double density = pdf.getVal(&nset);
+    if(i > 0) cdf[i] = cdf[i - 1] + 0.5*(previous + density)*step;
+    previous = density;
+  }
+  x.setVal(x0);
+  for (auto& value : cdf) value /= cdf.back();
+}
+
+double TabulatedCdf::operator()(double x) const {
+  double position = (x - lo)/step;
+  if(position <= 0) return 0;
+  int i = int(position);
+  if(i >= int(cdf.size()) - 1) return 1;
+  double frac = position - i;
+  return cdf[i] + frac*(cdf[i + 1] - cdf[i]);
+}
+
+double TabulatedCdf::Inverse(double u) const {
+  auto it = std::upper_bound(cdf.begin(), cdf.end(), u);
+  if(it == cdf.begin()) return lo;
+  if(it == cdf.end()) return lo + (cdf.size() - 1)*step;
+  int i = it - cdf.begin() - 1;
+  double width = cdf[i + 1] - cdf[i];
+  double frac = width > 0 ? (u - cdf[i])/width : 0;
+  return lo + (i + frac)*step;
+}
+
+void rootfitter::EdfStatistics(const std::vector<double> &sorted, const TabulatedCdf &cdf, double &ks, double &ad){
+  ks = 0;
+  ad = 0;
+  unsigned int n = sorted.size();
+  if(n == 0) return;
+  std::vector<double> F(n);
+  for (unsigned int i = 0; i < n; ++i) F[i] = std::min(std::max(cdf(sorted[i]), 1e-15), 1 - 1e-15); // keep the logs finite
+  double sum = 0;
+  for (unsigned int i = 0; i < n; ++i){
+    ks = std::max(ks, std::max(F[i] - double(i)/n, double(i + 1)/n - F[i]));
+    sum += (2.*i + 1)*(std::log(F[i]) + std::log(1 - F[n - 1 - i]));
+  }
+  ad = -double(n) - sum/n;
+}
+
+std::vector<double> rootfitter::SortedColumn(TTree *tree, const char *branch, double lo, double hi){
+  std::vector<double> values;
+  Float_t value = 0;
+  tree->SetBranchAddress(branch, &value);
+  values.reserve(tree->GetEntries());
+  for (Long64_t i = 0; i < tree->GetEntries(); ++i){
+    tree->GetEntry(i);
+    if(value > lo and value < hi) values.push_back(value);
+  }
+  tree->ResetBranchAddresses();
+  std::sort(values.begin(), values.end());
+  return values;
+}
+
+unsigned int rootfitter::PoissonCount(double mean, double u){
+  if(mean <= 0) return 0;
+  // smallest k with cdf(k) > u, by bisection on the Poisson CDF
+  unsigned int lo = 0;
+  unsigned int hi = (unsigned int)(mean + 20*std::sqrt(mean) + 20);
+  while(lo < hi){
+    unsigned int mid = lo + (hi - lo)/2;
+    if(ROOT::Math::poisson_cdf(mid, mean) > u) hi = mid;
+    else lo = mid + 1;
+  }
+  return lo;
+}
+
+GofResult rootfitter::UnbinnedGoodnessOfFit(const std::vector<double> &sorted, FitModel &fitted,
+                                            unsigned int n_toys, ULong64_t seed, unsigned int n_workers){
+  ScopedStage stage("GoodnessOfFit");
+  GofResult gof;
+  TabulatedCdf fitted_cdf(fitted.Pdf(), fitted.Momentum());
+  EdfStatistics(sorted, fitted_cdf, gof.ks, gof.ad);
+  if(n_toys == 0 or sorted.empty()) return gof;
+
+  std::unique_ptr<RooArgSet> params(fitted.Pdf().getParameters(RooArgSet(fitted.Momentum())));
+  RooArgList start(*params);
+  double mom_lo = fitted.Momentum().getMin();
+  double mom_hi = fitted.Momentum().getMax();
+  std::unique_ptr<FitModel> model; // one per worker process, built on its first toy
+  // a toy's record carries its fit status and its KS/AD against its own fit
+  std::vector<FitRecord> toys;
+  FitInProcesses(n_toys, n_workers, [&](unsigned int t, FitRecord &record){
+      // extended fit: the toy size is Poisson around the data size, its momenta drawn from the fitted CDF
+      std::vector<double> toy(PoissonCount(sorted.size(), CounterUniform(seed, kToySizeCounter, t)));
+      if(toy.empty()) return;
+      for (unsigned int i = 0; i < toy.size(); ++i) toy[i] = fitted_cdf.Inverse(CounterUniform(seed, i, t));
+      std::sort(toy.begin(), toy.end());
+      if(!model) model.reset(new FitModel(mom_lo, mom_hi));
+      RooRealVar &recomom = model->Momentum();
+      RooDataSet data("gof_toy", "goodness-of-fit toy", RooArgSet(recomom));
+      for (double mom : toy){
+        recomom.setVal(mom);
+        data.add(RooArgSet(recomom));
+      }
+      model->Reset();
+      model->SetParameters(start);
+      FitAndRecord(*model, data, record);
+      if(record.status == 0){
+        TabulatedCdf cdf(model->Pdf(), recomom);
+        EdfStatistics(toy, cdf, record.ks, record.ad);
+      }
+    }, toys);
+
+  unsigned int n_ks = 0, n_ad = 0;
+  for (auto const& toy : toys){
+    if(toy.status != 0) continue;
+    ++gof.n_toys;
+    if(toy.ks >= gof.ks) ++n_ks;
+    if(toy.ad >= gof.ad) ++n_ad;
+  }
+  if(gof.n_toys > 0){
+    gof.ks_pvalue = double(n_ks)/gof.n_toys;
+    gof.ad_pvalue = double(n_ad)/gof.n_toys;
+  }
+  std::cout<<"Goodness of fit: KS D = "<<gof.ks<<" (p = "<<gof.ks_pvalue<<"), AD A2 = "<<gof.ad<<" (p = "<<gof.ad_pvalue<<") from "<<gof.n_toys<<" toys"<<std::endl;
+  return gof;
+}
@@ -1,4 +1,18 @@
 #include "ReferenceAna/inc/Likelihood.hh"
+#include "ReferenceAna/inc/RunReport.hh"
+#include "ReferenceAna/inc/TemplateMorphing.hh"
+#include "ReferenceAna/inc/EventSelection.hh"
+#include "RooCategory.h"
+#include "RooExponential.h"
+#include "RooProdPdf.h"
+#include "RooConstVar.h"
+#include "RooFormulaVar.h"
+#include "RooSimultaneous.h"
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include "Fit/Fitter.h"
+#include "Math/Minimizer.h"
 using namespace rootfitter;
 
 
@@ -15,30 +29,58 @@ TString Likelihood::GetLabel(TString run){
   return pass;
 }
 
-template <class T> void Likelihood::MakePlots(RooRealVar recomom, T chMom, RooAddPdf fitFun, TString tag, TString recocuts){
-    TCanvas *can = new TCanvas("can", "", 100, 100, 600, 600);
+void Likelihood::SetPlotOutput(TString name, bool plots){
+  name.ReplaceAll("/", "_");
+  fPlotName = name;
+  fPlots = plots;
+}
+
+TString Likelihood::PlotName(TString stem) const {
+  return fPlotName == "" ? stem : stem + "_" + fPlotName;
+}
 
-    RooPlot *chFrame = recomom.frame(Title(""));
-    chMom.plotOn(chFrame, MarkerColor(kBlack), LineColor(kBlack), MarkerSize(0.5), Name("chMom"));
-    fitFun.plotOn(chFrame, LineColor(kGreen), LineStyle(1), Name("combFit"));
+template <class T> void Likelihood::MakePlots(RooRealVar &recomom, T &chMom, RooAbsPdf &fitFun, TString tag, TString recocuts){
+    if(!fPlots) return;
+    ScopedStage stage("MakePlots");
+    std::unique_ptr<TCanvas> can(new TCanvas(PlotName("can"), "", 100, 100, 600, 600));
 
-    float chiSq = chFrame->chiSquare(11);
-    std::cout << "chi2: " << chiSq << "; Probability: " << Prob(chiSq, 151) << std::endl;
+    std::unique_ptr<RooPlot> chFrame(recomom.frame(Title("")));
+    chMom.plotOn(chFrame.get(), MarkerColor(kBlack), LineColor(kBlack), MarkerSize(0.5), Name("chMom"));
+    fitFun.plotOn(chFrame.get(), LineColor(kGreen), LineStyle(1), Name("combFit"));
+
+    // chiSquare returns chi2/ndf; like RooCurve::chiSquare, ndf counts only the non-empty
+    // bins inside the curve, minus the floating parameters
+    std::unique_ptr<RooArgSet> params(fitFun.getParameters(RooArgSet(recomom)));
+    int n_params = 0;
+    for (auto *par : *params) if(!par->isConstant()) ++n_params;
+    RooHist *hist = chFrame->getHist("chMom");
+    RooCurve *curve = chFrame->getCurve("combFit");
+    double xstart, xstop, x, y;
+    curve->GetPoint(0, xstart, y);
+    curve->GetPoint(curve->GetN() - 1, xstop, y);
+    int n_bins = 0;
+    for (int i = 0; i < hist->GetN(); ++i){
+      hist->GetPoint(i, x, y);
+      if(y != 0 and x >= xstart and x <= xstop) ++n_bins;
+    }
+    int ndf = n_bins - n_params;
+    float chiSq = chFrame->chiSquare(n_params);
+    std::cout << "chi2/ndf: " << chiSq << " (ndf " << ndf << "); Probability: " << Prob(chiSq*ndf, ndf) << std::endl;
     
-    TPaveLabel *pchi2 = new TPaveLabel(0.5, 0.70, 0.35, 0.80, Form("#chi^{2}/ndf = %4.2f", chiSq), "brNDC");
+    TPaveLabel *pchi2 = new TPaveLabel(0.5, 0.70, 0.35, 0.80, Form("#chi^{2}/ndf = %4.2f", chiSq), "brNDC"); // owned by the frame
     pchi2 -> SetFillStyle(0);
     pchi2 -> SetBorderSize(0);
     pchi2 -> SetTextSize(0.25);
     pchi2 -> SetTextColor(kBlack);
     pchi2 -> SetFillColor(kWhite);
     chFrame -> addObject(pchi2);
-    auto *th1 = new TLatex(105 - 1, 100,"Mu2e Mock Data 2024");
+    std::unique_ptr<TLatex> th1(new TLatex(105 - 1, 100,"Mu2e Mock Data 2024"));
     th1->SetTextAlign(31); 
     th1->SetTextSize(0.05);
-    auto *th2 = new TLatex(105 - 1 , 50, tag);
+    std::unique_ptr<TLatex> th2(new TLatex(105 - 1 , 50, tag));
     th2->SetTextAlign(31); 
     th2->SetTextSize(0.03);
-    auto *th3 = new TLatex(105 - 1 , 20, recocuts);
+    std::unique_ptr<TLatex> th3(new TLatex(105 - 1 , 20, recocuts));
     th3->SetTextAlign(31); 
     th3->SetTextSize(0.03);
 
@@ -51,56 +93,80 @@ template <class T> void Likelihood::MakePlots(RooRealVar recomom, T chMom, RooAd
     th3->Draw("same");
     can -> SetLogy();
     can -> Update();
-    can -> SaveAs("CombinedFitResult.root");
+    can -> SaveAs(PlotName("CombinedFitResult") + ".root");
 
     
 }
 
 
-template <class T> RooFitResult *Likelihood::MakeLikelihood(RooAddPdf &fitFun, T chMom, RooRealVar nsig, RooRealVar recomom)
+RooFitResult *Likelihood::Minimize(RooMinimizer &m){
+    int calls0 = m.evalCounter();
+    {
+      ScopedStage stage("Migrad");
+      m.migrad();
+      stage.AddNLLCalls(m.evalCounter() - calls0);
+      if(m.fitter()->GetMinimizer()) stage.AddIterations(m.fitter()->GetMinimizer()->NIterations());
+    }
+    calls0 = m.evalCounter();
+    {
+      ScopedStage stage("Hesse");
+      m.hesse();
+      stage.AddNLLCalls(m.evalCounter() - calls0);
+    }
+    return m.save();
+}
+
+template <class T> RooFitResult *Likelihood::MakeLikelihood(RooAbsPdf &fitFun, T &chMom, RooRealVar &nsig, RooRealVar &recomom)
 {
-    TCanvas *can2 = new TCanvas("can2","");
-    RooPlot *chFrame2 = nsig.frame(RooFit::Bins(60), RooFit::Range(-1,50));
-    RooAbsReal* nll = fitFun.createNLL(chMom);
+    std::unique_ptr<RooAbsReal> nll(fitFun.createNLL(chMom, CloneData(false)));
     RooMinimizer m(*nll);
-    m.migrad();
-    m.hesse();
-    RooFitResult *fitRes = m.save();
+    RooFitResult *fitRes = Minimize(m);
+    if(!fPlots) return fitRes;
+    std::unique_ptr<TCanvas> can2(new TCanvas(PlotName("can2"),""));
+    std::unique_ptr<RooPlot> chFrame2(nsig.frame(RooFit::Bins(60), RooFit::Range(-1,50)));
     //RooAbsReal *pll = nll->createProfile(nsig);
     //pll->plotOn(chFrame2, RooFit::ShiftToZero(), LineColor(kGreen), LineStyle(1), Name("pll"));
-    nll->plotOn(chFrame2, RooFit::ShiftToZero(), LineColor(kRed), LineStyle(1), Name("nll"));
+    ScopedStage scan("NLLScan");
+    nll->plotOn(chFrame2.get(), RooFit::ShiftToZero(), LineColor(kRed), LineStyle(1), Name("nll"));
     chFrame2->SetMinimum(-1);
     chFrame2->SetMaximum(5);
     chFrame2->Draw();
     can2 -> Update();
-    can2 -> SaveAs("nll.root");
+    can2 -> SaveAs(PlotName("nll") + ".root");
     return fitRes;
 }
 
-template <class T> RooFitResult *Likelihood::MakeProfileLikelihood(RooAddPdf &fitFun, T chMom, RooRealVar nsig, RooRealVar recomom)
+template <class T> RooFitResult *Likelihood::MakeProfileLikelihood(RooAbsPdf &fitFun, T &chMom, RooRealVar &nsig, RooRealVar &recomom)
 {
-    TCanvas *can2 = new TCanvas("can2","");
-    RooPlot *chFrame2 = nsig.frame(RooFit::Bins(60), RooFit::Range(-1,50));
-    RooAbsReal* nll = fitFun.createNLL(chMom);
+    std::unique_ptr<RooAbsReal> nll(fitFun.createNLL(chMom, CloneData(false)));
     RooMinimizer m(*nll);
-    m.migrad();
-    m.hesse();
-    RooFitResult *fitRes = m.save();
-    RooAbsReal *pll = nll->createProfile(nsig);
-    pll->plotOn(chFrame2, RooFit::ShiftToZero(), LineColor(kGreen), LineStyle(1), Name("pll"));
-    nll->plotOn(chFrame2, RooFit::ShiftToZero(), LineColor(kRed), LineStyle(1), Name("nll"));
+    RooFitResult *fitRes = Minimize(m);
+    if(!fPlots) return fitRes;
+    std::unique_ptr<TCanvas> can2(new TCanvas(PlotName("can2"),""));
+    std::unique_ptr<RooPlot> chFrame2(nsig.frame(RooFit::Bins(60), RooFit::Range(-1,50)));
+    ScopedStage scan("NLLScan");
+    std::unique_ptr<RooAbsReal> pll(nll->createProfile(nsig));
+    pll->plotOn(chFrame2.get(), RooFit::ShiftToZero(), LineColor(kGreen), LineStyle(1), Name("pll"));
+    nll->plotOn(chFrame2.get(), RooFit::ShiftToZero(), LineColor(kRed), LineStyle(1), Name("nll"));
     chFrame2->SetMinimum(-1);
     chFrame2->SetMaximum(5);
     chFrame2->Draw();
     can2 -> Update();
-    can2 -> SaveAs("nllandpll.root");
+    can2 -> SaveAs(PlotName("nllandpll") + ".root");
     return fitRes;
 }
 
-double Likelihood::ReturnRmu(RooRealVar nsig, RooRealVar ndio){
-  double muons_dios_full = ndio.getValV()/3.64e-11;
-  double number_of_stopped_muons = muons_dios_full/0.39;
-  double number_of_captures = number_of_stopped_muons*0.61; 
+// DIO fraction in the fit window, decay and capture fractions of stopped muons
+static const double kDIOFractionInWindow = 3.64e-11;
+static const double kDecayFraction = 0.39;
+static const double kCaptureFraction = 0.61;
+// the same conversion as a RooFormulaVar of the DIO yield
+static const TString kCapturesFromDIO = Form("@0/%.17g/%.17g*%.17g", kDIOFractionInWindow, kDecayFraction, kCaptureFraction);
+
+double Likelihood::ReturnRmu(const RooAbsReal &nsig, const RooAbsReal &ndio){
+  double muons_dios_full = ndio.getValV()/kDIOFractionInWindow;
+  double number_of_stopped_muons = muons_dios_full/kDecayFraction;
+  double number_of_captures = number_of_stopped_muons*kCaptureFraction; 
   double Rmue = nsig.getValV()/number_of_captures;
   return Rmue;
 }
@@ -115,24 +181,11 @@ std::tuple <RooRealVar, RooRealVar, RooRealVar, RooRealVar>  Likelihood::CE_para
     return par_tuple;
 }
 
-std::tuple <RooRealVar, RooRealVar, RooRealVar, RooRealVar,RooRealVar, RooRealVar>  Likelihood::CE_DSCB(){
-    RooRealVar fMean("mean", "mean", 104, 103, 105);
-    RooRealVar fWidth("sigma", "sigma", 2.67104e-01, 0.1, 1.0);
-    RooRealVar ANeg("ANeg", "ANeg", 4.2e-01, 3e-01, 5e-01);
-    RooRealVar PNeg("PNeg", "PNeg", 2.51002e+01, 20,30);
-    RooRealVar APos("APos", "APos", 2.22666e+00, 2,3);
-    RooRealVar PPos("PPos", "PPos", 5.95360,5,7);
-    std::tuple <RooRealVar, RooRealVar, RooRealVar, RooRealVar,RooRealVar, RooRealVar> par_tuple = make_tuple(fMean,fWidth,ANeg,PNeg,APos,PPos);
-    return par_tuple;
-}
-
-std::tuple <RooRealVar, RooRealVar, RooRealVar, RooRealVar>  Likelihood::DIO_parameters(){
-    RooRealVar a5("a5", "a5", 8.6434e-17, 8.5e-17, 8.7e-17);
-    RooRealVar a6("a6", "a6", 1.16874e-17, 1.1e-17, 1.2e-17);
-    RooRealVar a7("a7", "a7", -1.87828e-19, -1.9e-19, -1.8e-19);
-    RooRealVar a8("a8", "a8", 9.16327e-20, 9.1e-20, 9.2e-20);
-    std::tuple <RooRealVar, RooRealVar, RooRealVar, RooRealVar> par_tuple = make_tuple(a5,a6,a7,a8);
-    return par_tuple;
+FitModel& Likelihood::Model(double mom_lo, double mom_hi){
+    std::unique_ptr<FitModel> &model = fModels[std::make_pair(mom_lo, mom_hi)];
+    if(!model) model.reset(new FitModel(mom_lo, mom_hi));
+    model->Reset();
+    return *model;
 }
 
 std::tuple <RooRealVar, RooRealVar>  Likelihood::RPC_parameters(){
@@ -144,97 +197,267 @@ std::tuple <RooRealVar, RooRealVar>  Likelihood::RPC_parameters(){
 }
 
 //TODO - we should remove the option for a binned version, we want unbinned eventually.
-RooFitResult *Likelihood::CalculateBinnedLikelihood(TH1F *hist_mom1, TString runname, bool usecuts, double mom_lo, double mom_hi, std::tuple <double, double, double, double>& recoresult)
+RooFitResult *Likelihood::CalculateBinnedLikelihood(TH1F *hist_mom1, TString runname, bool usecuts, double mom_lo, double mom_hi, FitRecord& record)
 {
     TString recocuts = "";
     if(usecuts) recocuts = "Cuts Applied";
     else recocuts = "No Cuts";
     TString tag = GetLabel(runname);
     
-    // make RooFit objects
-    RooRealVar recomom("recomom", "reco mom [MeV/c]", mom_lo, mom_hi);
-    RooDataHist chMom("chMom", "chMom", recomom, hist_mom1); //TODO unbinned use RooDataSet
-
-    // CE signal shape:
-    std::tuple <RooRealVar, RooRealVar, RooRealVar, RooRealVar, RooRealVar, RooRealVar>  CEparams = CE_DSCB();
-    RooDSCB Sig("Sig", "signal peak", recomom, get<0>(CEparams),get<1>(CEparams),get<2>(CEparams),get<3>(CEparams),get<4>(CEparams),get<5>(CEparams));
-    RooRealVar nsig("nsig", "number of signal events", 0.0, 0.0, 100);
-   
-    // DIO shape:
-    std::tuple <RooRealVar, RooRealVar, RooRealVar, RooRealVar> DIOparams = DIO_parameters();
-    RooRealVar ndio("ndio", "number in dio region", 0.0, 0.0, 100000);
-    RooPol58 DIO("DIO", "dio tail", recomom, get<0>(DIOparams), get<1>(DIOparams),get<2>(DIOparams),get<3>(DIOparams));
-    
-    // Cosmic shape:
-    RooUniform Cosmic("Cosmic", "cosmic", recomom);
-    RooRealVar ncosmics("ncosmics", "number of cosmics", 0.0, 0.0, 10);
-    
-    // RPC shape:
-    /*std::tuple <RooRealVar, RooRealVar> RPCparams = RPC_parameters();
-    RooGaussian RPC("RPC", "RPC", recomom, get<0>(RPCparams), get<1>(RPCparams));
-    RooRealVar nrpc("nrpc", "number of rpc", 0.0, 0.0, 1.0);*/
-    
+    // CE (RooDSCB) + DIO (RooPol58) + cosmic (flat), extended
+    // RPC shape: TODO for when we have RPC, see RPC_parameters()
+    FitModel &model = Model(mom_lo, mom_hi);
+    ScopedStage datastage("BuildDataset");
+    RooDataHist chMom("chMom", "chMom", model.Momentum(), hist_mom1); //TODO unbinned use RooDataSet
+    datastage.Stop();
+    return FitAndPlot(model, chMom, tag, recocuts, record);
+}
+
+//TODO the unbinned and binned fits are basically the same except hist<--> tree and DataHist <--> DataSet, we can probably tempalte these...
+
+RooFitResult *Likelihood::CalculateUnbinnedLikelihood(TTree *mom, TString runname, bool usecuts, double mom_lo, double mom_hi, FitRecord& record)
+{
+    TString recocuts = "";
+    if(usecuts) recocuts = "Cuts Applied";
+    else recocuts = "No Cuts";
+    TString tag = GetLabel(runname);
     
-    //combined binned ML (extended)
-    RooAddPdf fitFun("fitFun", "Sig + DIO + Cosmic ", RooArgList(Sig, DIO, Cosmic), RooArgList(nsig, ndio, ncosmics)); 
-   
+    FitModel &model = Model(mom_lo, mom_hi);
+    ScopedStage datastage("BuildDataset");
+    RooDataSet chMom("chMom", "chMom",RooArgSet(model.Momentum()), Import(*mom));
+    datastage.AddEntries(chMom.numEntries());
+    datastage.Stop();
+    return FitAndPlot(model, chMom, tag, recocuts, record);
+}
+
+RooFitResult *Likelihood::FitAndPlot(FitModel &model, RooAbsData &chMom, TString tag, TString recocuts, FitRecord& record)
+{
     // run profile
-    RooFitResult *fitRes = MakeLikelihood(fitFun, chMom, nsig, recomom);
+    double wall0 = WallSeconds();
+    double cpu0 = CpuSeconds();
+    RooFitResult *fitRes = MakeLikelihood(model.Pdf(), chMom, model.NSig(), model.Momentum());
+    record.fit_wall_s = WallSeconds() - wall0;
+    record.fit_cpu_s = CpuSeconds() - cpu0;
     
-    // run profile
-    MakePlots(recomom, chMom, fitFun, tag, recocuts);
+    //make fit plots
+    MakePlots(model.Momentum(), chMom, model.Pdf(), tag, recocuts);
     
-    //print results
-    recoresult = make_tuple(nsig.getValV(), ndio.getValV(), ncosmics.getValV(), 0);
-    std::cout<<" derived Rmue "<<ReturnRmu(nsig,ndio)<<std::endl;
+    FillFitRecord(*fitRes, record);
+    record.rmue = model.Rmue();
+    std::cout<<" derived Rmue "<<record.rmue<<std::endl;
+    RunReport::Instance().SetResult("Rmue", record.rmue);
     return fitRes;
 }
 
-//TODO the unbinned and binned fits are basically the same except hist<--> tree and DataHist <--> DataSet, we can probably tempalte these...
+GofResult Likelihood::GoodnessOfFit(TTree *mom, double mom_lo, double mom_hi, unsigned int n_toys, ULong64_t seed, unsigned int n_workers)
+{
+    auto it = fModels.find(std::make_pair(mom_lo, mom_hi));
+    if(it == fModels.end()) throw std::runtime_error("GoodnessOfFit: no fit in this momentum window");
+    std::vector<double> sorted = SortedColumn(mom, "recomom", mom_lo, mom_hi);
+    return UnbinnedGoodnessOfFit(sorted, *it->second, n_toys, seed, n_workers);
+}
 
-RooFitResult *Likelihood::CalculateUnbinnedLikelihood(TTree *mom, TString runname, bool usecuts, double mom_lo, double mom_hi, std::tuple <double, double, double, double>& recoresult)
+// unbinned fit with the CE and DIO shapes morphed between templates; the nuisance
+// parameters are profiled with their Gaussian constraints
+RooFitResult *Likelihood::CalculateMorphedLikelihood(TTree *mom, const MomentumTemplates &templates, TString runname, bool usecuts, double mom_lo, double mom_hi, FitRecord& record)
 {
     TString recocuts = "";
     if(usecuts) recocuts = "Cuts Applied";
     else recocuts = "No Cuts";
     TString tag = GetLabel(runname);
-    
-    // make RooFit objects
-    RooRealVar recomom("recomom", "reco mom [MeV/c]", mom_lo, mom_hi);
-    
-    // CE signal shape:
-    //std::tuple <RooRealVar, RooRealVar, RooRealVar, RooRealVar> CEparams = CE_parameters();
-    //RooCBShape Sig("Sig", "signal peak", recomom, get<0>(CEparams), get<1>(CEparams),get<2>(CEparams),get<3>(CEparams));
-    std::tuple <RooRealVar, RooRealVar, RooRealVar, RooRealVar, RooRealVar, RooRealVar>  CEparams = CE_DSCB();
-    RooDSCB Sig("Sig", "signal peak", recomom, get<0>(CEparams),get<1>(CEparams),get<2>(CEparams),get<3>(CEparams),get<4>(CEparams),get<5>(CEparams));
-    RooRealVar nsig("nsig", "number of signal events", 0.0, 0.0, 100);
-   
-    // DIO shape:
-    std::tuple <RooRealVar, RooRealVar, RooRealVar, RooRealVar> DIOparams = DIO_parameters();
-    RooRealVar ndio("ndio", "number in dio region", 0.0, 0.0, 100000);
-    RooPol58 DIO("DIO", "dio tail", recomom, get<0>(DIOparams), get<1>(DIOparams),get<2>(DIOparams),get<3>(DIOparams));
-    
-    // Cosmic shape:
-    RooUniform Cosmic("Cosmic", "cosmic", recomom);
-    RooRealVar ncosmics("ncosmics", "fraction of cosmics", 0.0, 0.0, 10);
-    
-    // RPC shape: TODO for when we have RPC
-    /*std::tuple <RooRealVar, RooRealVar> RPCparams = RPC_parameters();
-    RooGaussian RPC("RPC", "RPC", recomom, get<0>(RPCparams), get<1>(RPCparams));
-    RooRealVar nrpc("nrpc", "number of rpc", 0.0, 0.0, 1.0);*/
-    
-    //combined unbinned ML (extended)
-    RooAddPdf fitFun("fitFun", "Sig + DIO + Cosmic ", RooArgList(Sig, DIO, Cosmic), RooArgList(nsig, ndio, ncosmics)); 
+
+    MorphingModel model(templates, mom_lo, mom_hi);
+    RooRealVar &recomom = model.Momentum();
+    ScopedStage datastage("BuildDataset");
     RooDataSet chMom("chMom", "chMom",RooArgSet(recomom), Import(*mom));
-    
-    // run profile
+    datastage.AddEntries(chMom.numEntries());
+    datastage.Stop();
+
+    double wall0 = WallSeconds();
+    double cpu0 = CpuSeconds();
+    std::unique_ptr<RooAbsReal> nll(model.Pdf().createNLL(chMom, ExternalConstraints(model.Constraints())));
+    RooMinimizer m(*nll);
+    RooFitResult *fitRes = Minimize(m);
+    record.fit_wall_s = WallSeconds() - wall0;
+    record.fit_cpu_s = CpuSeconds() - cpu0;
+
+    MakePlots(recomom, chMom, model.Pdf(), tag, recocuts);
+
+    for (auto *arg : model.Nuisances()){
+      RooRealVar *alpha = static_cast<RooRealVar*>(arg);
+      std::cout<<" nuisance "<<alpha->GetName()<<" = "<<alpha->getVal()<<" +- "<<alpha->getError()<<std::endl;
+      RunReport::Instance().SetResult(alpha->GetName(), alpha->getVal());
+    }
+    FillFitRecord(*fitRes, record);
+    record.rmue = ReturnRmu(model.Yield("nsig"), model.Yield("ndio"));
+    std::cout<<" derived Rmue "<<record.rmue<<std::endl;
+    RunReport::Instance().SetResult("Rmue", record.rmue);
+    return fitRes;
+}
+
+// one RooSimultaneous over the categories: CE and DIO shapes and Rmue are shared,
+// each category has its own DIO and cosmic yields and nsig = Rmue x captures.
+// records[0] is the combined result, then one record per category.
+RooFitResult *Likelihood::CalculateSimultaneousLikelihood(const std::vector<FitCategory> &categories, double mom_lo, double mom_hi, unsigned int n_cpu, std::vector<FitRecord>& records)
+{
+    // shared shapes, from the persistent model
+    FitModel &model = Model(mom_lo, mom_hi);
+    RooRealVar &recomom = model.Momentum();
+    RooDSCB &Sig = model.Signal();
+    RooPol58 &DIO = model.DIOShape();
+    RooUniform &Cosmic = model.CosmicShape();
+    RooRealVar Rmue("Rmue", "R_{#mu e}", 1e-14, 0.0, 1e-11);
+
+    // per-category yields and exposure
+    RooCategory period("period", "run period");
+    for (auto const& category : categories) period.defineType(category.name);
+    std::vector<std::unique_ptr<RooAbsArg> > owned; // clients after their servers
+    std::unique_ptr<RooSimultaneous> simFun(new RooSimultaneous("simFun", "simultaneous Sig + DIO + Cosmic", period));
+    std::vector<std::unique_ptr<RooDataSet> > datasets;
+    std::map<std::string, RooDataSet*> data;
+    std::vector<RooRealVar*> ndios, ncosmics;
+    std::vector<RooAbsReal*> nsigs;
+    ScopedStage datastage("BuildDataset");
+    for (auto const& category : categories){
+      TString name = category.name;
+      RooRealVar *ndio = new RooRealVar("ndio_" + name, "number in dio region, " + name, 0.0, 0.0, 100000);
+      RooRealVar *ncosmic = new RooRealVar("ncosmics_" + name, "number of cosmics, " + name, 0.0, 0.0, 10);
+      owned.emplace_back(ndio);
+      owned.emplace_back(ncosmic);
+      RooAbsReal *captures = 0;
+      if(category.captures > 0) captures = new RooConstVar("captures_" + name, "muon captures, " + name, category.captures);
+      else captures = new RooFormulaVar("captures_" + name, "muon captures, " + name, kCapturesFromDIO, RooArgList(*ndio));
+      owned.emplace_back(captures);
+      RooFormulaVar *nsig = new RooFormulaVar("nsig_" + name, "number of signal events, " + name, "@0*@1", RooArgList(Rmue, *captures));
+      owned.emplace_back(nsig);
+      RooAddPdf *fitFun = new RooAddPdf("fitFun_" + name, "Sig + DIO + Cosmic, " + name, RooArgList(Sig, DIO, Cosmic), RooArgList(*nsig, *ndio, *ncosmic));
+      owned.emplace_back(fitFun);
+      simFun->addPdf(*fitFun, name);
+      ndios.push_back(ndio);
+      ncosmics.push_back(ncosmic);
+      nsigs.push_back(nsig);
+
+      datasets.emplace_back(new RooDataSet("chMom_" + name, "chMom_" + name, RooArgSet(recomom), Import(*category.mom)));
+      data[name.Data()] = datasets.back().get();
+    }
+    RooDataSet chMom("chMom", "chMom", RooArgSet(recomom), Index(period), Import(data));
+    datastage.AddEntries(chMom.numEntries());
+    datastage.Stop();
+
+    // each category's NLL in its own process
+    double wall0 = WallSeconds();
+    double cpu0 = CpuSeconds();
+    std::unique_ptr<RooAbsReal> nll(n_cpu > 1 ? simFun->createNLL(chMom, NumCPU(n_cpu, RooFit::SimComponents)) : simFun->createNLL(chMom, CloneData(false)));
+    RooMinimizer m(*nll);
+    RooFitResult *fitRes = Minimize(m);
+    double wall = WallSeconds() - wall0;
+    double cpu = CpuSeconds() - cpu0;
+    nll.reset();
+
+    records.assign(categories.size() + 1, FitRecord());
+    FitRecord &combined = records[0];
+    FillFitRecord(*fitRes, combined);
+    combined.fit_wall_s = wall;
+    combined.fit_cpu_s = cpu;
+    combined.rmue = Rmue.getVal();
+    std::cout<<" shared Rmue "<<Rmue.getVal()<<" +- "<<Rmue.getError()<<std::endl;
+    for (unsigned int c = 0; c < categories.size(); ++c){
+      FitRecord &record = records[c + 1];
+      record.name = categories[c].name;
+      record.status = combined.status;
+      record.covqual = combined.covqual;
+      record.edm = combined.edm;
+      record.minnll = combined.minnll;
+      record.nsig = nsigs[c]->getVal();
+      record.nsig_err = nsigs[c]->getPropagatedError(*fitRes);
+      record.ndio = ndios[c]->getVal();
+      record.ndio_err = ndios[c]->getError();
+      record.ncosmics = ncosmics[c]->getVal();
+      record.ncosmics_err = ncosmics[c]->getError();
+      record.rmue = combined.rmue;
+      combined.nsig += record.nsig;
+      combined.ndio += record.ndio;
+      combined.ncosmics += record.ncosmics;
+      std::cout<<"  "<<record.name<<": NSig = "<<record.nsig<<" NDIO = "<<record.ndio<<" NCOSMIC = "<<record.ncosmics<<std::endl;
+    }
+    RunReport::Instance().SetResult("Rmue", Rmue.getVal());
+    RunReport::Instance().SetResult("Rmue_err", Rmue.getError());
+
+    simFun.reset();
+    while(!owned.empty()) owned.pop_back();
+    return fitRes;
+}
+
+// momentum x t0 and/or trkqual: per component a product of one-dimensional PDFs, each
+// with an analytic integral. RooProdPdf normalises every factor over its own observable
+// and keeps those integrals cached until that factor's parameters change.
+RooFitResult *Likelihood::CalculateMultiObservableLikelihood(TTree *mom, int fitted, TString runname, bool usecuts, double mom_lo, double mom_hi, FitRecord& record)
+{
+    TString recocuts = "";
+    if(usecuts) recocuts = "Cuts Applied";
+    else recocuts = "No Cuts";
+    TString tag = GetLabel(runname);
+
+    // momentum shapes and yields, as in the one-dimensional fit
+    FitModel &model = Model(mom_lo, mom_hi);
+    RooRealVar &recomom = model.Momentum();
+    RooDSCB &Sig = model.Signal();
+    RooPol58 &DIO = model.DIOShape();
+    RooUniform &Cosmic = model.CosmicShape();
+    RooRealVar t0("t0", "track t0 [ns]", 500, 1695);
+    RooRealVar trkqual("trkqual", "track quality", 0, 1);
+
+    // t0: CE and DIO follow the muon decay in Al, cosmics are flat
+    RooRealVar t0slope("t0slope", "-1/lifetime [1/ns]", -1/864., -0.01, 0.0);
+    RooExponential TrackT0("TrackT0", "stopped muon t0", t0, t0slope);
+    RooUniform CosmicT0("CosmicT0", "cosmic t0", t0);
+
+    // trkqual: CE and DIO tracks peak towards 1, cosmics have their own slope
+    RooRealVar qualslope("qualslope", "trkqual slope", 5, 0, 50);
+    RooExponential TrackQual("TrackQual", "stopped muon trkqual", trkqual, qualslope);
+    RooRealVar cosmicqualslope("cosmicqualslope", "cosmic trkqual slope", 0, -20, 20);
+    RooExponential CosmicQual("CosmicQual", "cosmic trkqual", trkqual, cosmicqualslope);
+
+    RooArgSet observables(recomom);
+    RooArgList sigTerms(Sig), dioTerms(DIO), cosmicTerms(Cosmic);
+    if(fitted & kFitT0){
+      observables.add(t0);
+      sigTerms.add(TrackT0);
+      dioTerms.add(TrackT0);
+      cosmicTerms.add(CosmicT0);
+    }
+    if(fitted & kFitTrkQual){
+      observables.add(trkqual);
+      sigTerms.add(TrackQual);
+      dioTerms.add(TrackQual);
+      cosmicTerms.add(CosmicQual);
+    }
+    RooProdPdf SigProd("SigProd", "CE", sigTerms);
+    RooProdPdf DIOProd("DIOProd", "DIO", dioTerms);
+    RooProdPdf CosmicProd("CosmicProd", "cosmic", cosmicTerms);
+
+    RooRealVar &nsig = model.NSig();
+    RooRealVar &ndio = model.NDIO();
+    RooAddPdf fitFun("multiFun", "Sig + DIO + Cosmic ", RooArgList(SigProd, DIOProd, CosmicProd), RooArgList(nsig, ndio, model.NCosmics()));
+
+    ScopedStage datastage("BuildDataset");
+    RooDataSet chMom("chMom", "chMom", observables, Import(*mom));
+    datastage.AddEntries(chMom.numEntries());
+    datastage.Stop();
+    std::cout<<" fitting "<<observables.getSize()<<" observables to "<<chMom.numEntries()<<" candidates"<<std::endl;
+
+    double wall0 = WallSeconds();
+    double cpu0 = CpuSeconds();
     RooFitResult *fitRes = MakeLikelihood(fitFun, chMom, nsig, recomom);
-    
-    //make fit plots
+    record.fit_wall_s = WallSeconds() - wall0;
+    record.fit_cpu_s = CpuSeconds() - cpu0;
+
+    // momentum projection, integrated over the other observables
     MakePlots(recomom, chMom, fitFun, tag, recocuts);
-    
-    recoresult = make_tuple(nsig.getValV(), ndio.getValV(), ncosmics.getValV(), 0);
-    
-    std::cout<<" derived Rmue "<<ReturnRmu(nsig,ndio)<<std::endl;
+
+    FillFitRecord(*fitRes, record);
+    record.rmue = ReturnRmu(nsig,ndio);
+    std::cout<<" derived Rmue "<<record.rmue<<std::endl;
+    RunReport::Instance().SetResult("Rmue", record.rmue);
     return fitRes;
 }
@@ -0,0 +1,92 @@
+#include "ReferenceAna/inc/OnlineFit.hh"
+#include "ReferenceAna/inc/EventSelection.hh"
+#include "ReferenceAna/inc/RunReport.hh"
+#include <algorithm>
+#include <iostream>
+#include "TFile.h"
+#include "TSystem.h"
+#include "RooDataHist.h"
+using namespace rootfitter;
+
+OnlineFit::OnlineFit(TString directory, bool usecuts, double mom_lo, double mom_hi, bool binned) :
+  directory(directory),
+  usecuts(usecuts),
+  binned(binned),
+  model(mom_lo, mom_hi),
+  data("online_data", "accumulated candidates", RooArgSet(model.Momentum())),
+  hist("online_hist", "accumulated reco mom", 100, mom_lo, mom_hi),
+  truth(mom_lo, mom_hi)
+{
+  hist.SetDirectory(0);
+}
+
+std::vector<TString> OnlineFit::NewFiles(){
+  std::vector<TString> ready;
+  void *dir = gSystem->OpenDirectory(directory);
+  if(!dir){
+    std::cout<<"OnlineFit: cannot read "<<directory<<std::endl;
+    return ready;
+  }
+  while(const char *entry = gSystem->GetDirEntry(dir)){
+    TString name = entry;
+    if(!name.EndsWith(".tka") or processed.count(name)) continue;
+    FileStat_t stat;
+    if(gSystem->GetPathInfo(directory + "/" + name, stat) != 0) continue;
+    auto it = sizes.find(name);
+    if(it != sizes.end() and it->second == stat.fSize) ready.push_back(name);
+    else sizes[name] = stat.fSize;
+  }
+  gSystem->FreeDirectory(dir);
+  std::sort(ready.begin(), ready.end());
+  return ready;
+}
+
+Long64_t OnlineFit::AddFile(TString filename){
+  ScopedStage stage("Selection");
+  processed.insert(filename);
+  sizes.erase(filename);
+  std::unique_ptr<TFile> file(TFile::Open(directory + "/" + filename));
+  TTree *trkana = file ? static_cast<TTree*>(file->Get("TrkAna/trkana")) : 0;
+  if(!trkana){
+    std::cout<<"OnlineFit: no TrkAna/trkana in "<<filename<<", skipped"<<std::endl;
+    return 0;
+  }
+  TrkAnaEvent event;
+  event.SetBranchAddresses(trkana);
+  RooRealVar &recomom = model.Momentum();
+  Long64_t n_candidates = 0;
+  Long64_t n_events = trkana->GetEntries();
+  for (Long64_t i_event = 0; i_event < n_events; ++i_event) {
+    trkana->GetEntry(i_event);
+    truth.Fill(event, usecuts, [&](const mu2e::TrkFitInfo& fit){
+      double mom = fit.mom.R();
+      hist.Fill(mom);
+      if(mom > recomom.getMin() and mom < recomom.getMax()){
+        recomom.setVal(mom);
+        data.add(RooArgSet(recomom));
+        ++n_candidates;
+      }
+    });
+  }
+  stage.AddEntries(n_events);
+  std::cout<<"OnlineFit: "<<filename<<" added "<<n_candidates<<" candidates, "<<data.numEntries()<<" in total"<<std::endl;
+  return n_candidates;
+}
+
+const RooFitResult &OnlineFit::Update(FitRecord &record){
+  if(last) model.SetParameters(last->floatParsFinal());
+  double wall0 = WallSeconds();
+  double cpu0 = CpuSeconds();
+  if(binned){
+    RooDataHist datahist("online_datahist", "accumulated reco mom", RooArgList(model.Momentum()), &hist);
+    last.reset(model.Fit(datahist));
+  } else {
+    last.reset(model.Fit(data));
+  }
+  record.fit_wall_s = WallSeconds() - wall0;
+  record.fit_cpu_s = CpuSeconds() - cpu0;
+  FillFitRecord(*last, record);
+  record.rmue = model.Rmue();
+  truth.FillRecord(record);
+  return *last;
+}
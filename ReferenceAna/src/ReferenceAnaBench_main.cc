@@ -0,0 +1,291 @@
+/*
+Benchmarks for the ReferenceAna pipeline: PDF evaluation, NLL evaluation, migrad/hesse,
+per-fit setup (rebuilt vs reused model) and event-loop throughput. Results are written
+as JSON so runs on different reconstruction passes or ROOT versions can be compared.
+
+The synthetic event loop times the selection alone; given a TrkAna file, the ntuple loop
+also times TTree::GetEntry (I/O and unpacking), which dominates a real pass.
+
+usage: ReferenceAnaBench [output.json] [max threads] [events per loop] [trkana.root]
+*/
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "TFile.h"
+#include "TROOT.h"
+#include "TRandom3.h"
+#include "RooMsgService.h"
+#include "RooRandom.h"
+#include "ReferenceAna/inc/Likelihood.hh"
+#include "ReferenceAna/inc/FitModel.hh"
+#include "ReferenceAna/inc/RooCeMLL.hh"
+#include "ReferenceAna/inc/EventSelection.hh"
+
+using namespace std;
+using namespace rootfitter;
+
+template <class F> double TimeSeconds(F&& f){
+  auto start = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// one benchmark result, written as a JSON object
+struct BenchResult {
+  TString name;
+  std::vector<std::pair<TString, double> > values;
+};
+
+void WriteResults(TString outname, const std::vector<BenchResult>& results){
+  std::ofstream out(outname.Data());
+  out<<"{\n  \"root_version\": \""<<gROOT->GetVersion()<<"\",\n";
+  out<<"  \"hardware_threads\": "<<std::thread::hardware_concurrency()<<",\n";
+  out<<"  \"benchmarks\": [\n";
+  for (unsigned int i = 0; i < results.size(); ++i){
+    out<<"    {\"name\": \""<<results[i].name<<"\"";
+    for (auto& value : results[i].values) out<<", \""<<value.first<<"\": "<<value.second;
+    out<<"}"<<(i + 1 < results.size() ? "," : "")<<"\n";
+  }
+  out<<"  ]\n}\n";
+  std::cout<<"Benchmark results written to "<<outname<<std::endl;
+}
+
+BenchResult BenchPdf(TString name, RooAbsPdf& pdf, RooRealVar& recomom, int n_evals){
+  RooArgSet nset(recomom);
+  double step = (recomom.getMax() - recomom.getMin())/n_evals;
+  double sum = 0;
+  double seconds = TimeSeconds([&](){
+    for (int i = 0; i < n_evals; ++i){
+      recomom.setVal(recomom.getMin() + (i + 0.5)*step);
+      sum += pdf.getVal(&nset);
+    }
+  });
+  std::cout<<name<<": "<<1e9*seconds/n_evals<<" ns/event (checksum "<<sum<<")"<<std::endl;
+  return BenchResult{"pdf_eval_" + name, {{"ns_per_event", 1e9*seconds/n_evals}, {"n_evals", double(n_evals)}}};
+}
+
+void BenchPdfs(std::vector<BenchResult>& results, double mom_lo, double mom_hi){
+  FitModel model(mom_lo, mom_hi);
+  RooRealVar& recomom = model.Momentum();
+  const int n_evals = 1000000;
+
+  results.push_back(BenchPdf("RooDSCB", model.Signal(), recomom, n_evals));
+  results.push_back(BenchPdf("RooPol58", model.DIOShape(), recomom, n_evals));
+
+  // RooCeMLL diverges at E = eMax, so it is only normalisable below the endpoint
+  RooRealVar eMax("eMax", "eMax", 104.97);
+  RooRealVar me("me", "me", 0.511);
+  RooRealVar alpha("alpha", "alpha", 1./137.036);
+  RooRealVar cemom("cemom", "reco mom", mom_lo, std::min(mom_hi, 104.9));
+  RooCeMLL CeMLL("CeMLL", "conversion with leading log", cemom, eMax, me, alpha);
+  results.push_back(BenchPdf("RooCeMLL", CeMLL, cemom, n_evals));
+}
+
+void BenchFit(std::vector<BenchResult>& results, double mom_lo, double mom_hi, int n_fit_events){
+  FitModel model(mom_lo, mom_hi);
+  RooRealVar& recomom = model.Momentum();
+  RooAddPdf& fitFun = model.Pdf();
+  model.NSig().setVal(10);
+  model.NDIO().setVal(n_fit_events);
+  model.NCosmics().setVal(1);
+  // every timed fit starts from these values, as the benchmark always has
+  std::unique_ptr<RooArgSet> params(fitFun.getParameters(RooArgSet(recomom)));
+  RooArgSet start;
+  params->snapshot(start);
+
+  RooRandom::randomGenerator()->SetSeed(1234);
+  std::unique_ptr<RooDataSet> data(fitFun.generate(RooArgSet(recomom), n_fit_events));
+  std::unique_ptr<RooAbsReal> nll(fitFun.createNLL(*data, Extended(true), CloneData(false)));
+
+  // move the signal mean each call so the shapes and their normalisation are recomputed
+  RooRealVar& mean = model.SignalMean();
+  const int n_calls = 200;
+  double seconds = TimeSeconds([&](){
+    for (int i = 0; i < n_calls; ++i){
+      mean.setVal(i % 2 ? 104.0 : 104.01);
+      nll->getVal();
+    }
+  });
+  mean.setVal(104);
+  std::cout<<"NLL: "<<1e6*seconds/n_calls<<" us/call on "<<n_fit_events<<" events"<<std::endl;
+  results.push_back(BenchResult{"nll_eval", {{"us_per_call", 1e6*seconds/n_calls}, {"n_events", double(n_fit_events)}}});
+
+  const int n_fits = 5;
+  double migrad_seconds = 0;
+  double hesse_seconds = 0;
+  for (int i = 0; i < n_fits; ++i){
+    model.SetParameters(RooArgList(start));
+    RooMinimizer m(*nll);
+    m.setPrintLevel(-1);
+    migrad_seconds += TimeSeconds([&](){ m.migrad(); });
+    hesse_seconds += TimeSeconds([&](){ m.hesse(); });
+  }
+  std::cout<<"migrad: "<<1e3*migrad_seconds/n_fits<<" ms, hesse: "<<1e3*hesse_seconds/n_fits<<" ms"<<std::endl;
+  results.push_back(BenchResult{"migrad", {{"ms_per_fit", 1e3*migrad_seconds/n_fits}, {"n_events", double(n_fit_events)}}});
+  results.push_back(BenchResult{"hesse", {{"ms_per_fit", 1e3*hesse_seconds/n_fits}, {"n_events", double(n_fit_events)}}});
+
+  // per-fit setup before migrad: a new model and a cloned dataset every fit (as the fits
+  // used to do) against resetting the persistent model and fitting the data in place
+  const int n_setups = 50;
+  double rebuild_seconds = TimeSeconds([&](){
+    for (int i = 0; i < n_setups; ++i){
+      FitModel fresh(mom_lo, mom_hi);
+      std::unique_ptr<RooAbsReal> fresh_nll(fresh.Pdf().createNLL(*data, Extended(true)));
+      fresh_nll->getVal();
+    }
+  });
+  double reuse_seconds = TimeSeconds([&](){
+    for (int i = 0; i < n_setups; ++i){
+      model.Reset();
+      std::unique_ptr<RooAbsReal> reused_nll(fitFun.createNLL(*data, Extended(true), CloneData(false)));
+      reused_nll->getVal();
+    }
+  });
+  std::cout<<"fit setup: rebuild "<<1e3*rebuild_seconds/n_setups<<" ms, reuse "<<1e3*reuse_seconds/n_setups<<" ms"<<std::endl;
+  results.push_back(BenchResult{"fit_setup", {{"rebuild_ms", 1e3*rebuild_seconds/n_setups}, {"reuse_ms", 1e3*reuse_seconds/n_setups},
+                                              {"n_events", double(n_fit_events)}}});
+}
+
+// storage behind a TrkAnaEvent so the selection runs without file I/O
+struct SyntheticEvent {
+  std::vector<std::vector<mu2e::TrkFitInfo> > tracks;
+  std::vector<mu2e::CrvHitInfoReco> crvcoincs;
+  mu2e::MVAResultInfo trkqual;
+  std::vector<std::vector<mu2e::LoopHelixInfo>> lhs;
+  std::vector<std::vector<mu2e::SimInfo>> sims;
+};
+
+std::vector<SyntheticEvent> MakeSyntheticEvents(int n_events, int crv_multiplicity, TRandom3& rand){
+  std::vector<SyntheticEvent> events(n_events);
+  for (auto& ev : events){
+    mu2e::TrkFitInfo fit;
+    fit.sid = 0;
+    fit.time = rand.Uniform(500, 1700);
+    fit.mom.SetXYZ(0, 0, rand.Uniform(95, 106));
+    ev.tracks.push_back(std::vector<mu2e::TrkFitInfo>(1, fit));
+    mu2e::LoopHelixInfo lh;
+    lh.t0 = fit.time;
+    lh.t0err = rand.Uniform(0, 1.2);
+    lh.maxr = rand.Uniform(400, 700);
+    ev.lhs.push_back(std::vector<mu2e::LoopHelixInfo>(1, lh));
+    ev.trkqual.result = rand.Uniform();
+    mu2e::SimInfo sim;
+    sim.startCode = 166;
+    ev.sims.push_back(std::vector<mu2e::SimInfo>(1, sim));
+    for (int i = 0; i < crv_multiplicity; ++i){
+      mu2e::CrvHitInfoReco crv;
+      crv.time = rand.Uniform(0, 1700);
+      ev.crvcoincs.push_back(crv);
+    }
+  }
+  return events;
+}
+
+void BenchEventLoop(std::vector<BenchResult>& results, int n_events, unsigned int max_threads){
+  TRandom3 rand(4321);
+  for (int crv_multiplicity : {0, 1, 4, 16}){
+    std::vector<SyntheticEvent> events = MakeSyntheticEvents(n_events, crv_multiplicity, rand);
+    for (unsigned int n_threads = 1; n_threads <= max_threads; n_threads *= 2){
+      std::vector<long> n_selected(n_threads, 0);
+      double seconds = TimeSeconds([&](){
+        std::vector<std::thread> workers;
+        for (unsigned int t = 0; t < n_threads; ++t){
+          workers.emplace_back([&, t](){
+            TrkAnaEvent event;
+            long selected = 0;
+            for (int i = t; i < n_events; i += n_threads){
+              SyntheticEvent& ev = events[i];
+              event.tracks = &ev.tracks;
+              event.crvcoincs = &ev.crvcoincs;
+              event.trkquals = &ev.trkqual;
+              event.lhs = &ev.lhs;
+              event.sims = &ev.sims;
+              ForEachCandidate(event, true, [&](const mu2e::TrkFitInfo&){ selected++; });
+            }
+            n_selected[t] = selected;
+          });
+        }
+        for (auto& worker : workers) worker.join();
+      });
+      long total = 0;
+      for (long n : n_selected) total += n;
+      std::cout<<"event loop: crv multiplicity "<<crv_multiplicity<<", "<<n_threads<<" threads: "<<n_events/seconds<<" events/s ("<<total<<" selected)"<<std::endl;
+      results.push_back(BenchResult{"event_loop", {{"crv_multiplicity", double(crv_multiplicity)}, {"threads", double(n_threads)},
+                                                   {"events_per_s", n_events/seconds}, {"n_selected", double(total)}}});
+    }
+  }
+}
+
+// GetEntry + selection on a real ntuple; each thread opens the file and reads a contiguous block
+void BenchNTupleLoop(std::vector<BenchResult>& results, TString filename, unsigned int max_threads){
+  ROOT::EnableThreadSafety();
+  Long64_t n_entries = 0;
+  {
+    std::unique_ptr<TFile> file(TFile::Open(filename));
+    TTree *trkana = file ? (TTree*)file->Get("TrkAna/trkana") : 0;
+    if(!trkana){
+      std::cout<<"cannot read TrkAna/trkana from "<<filename<<", skipping the ntuple loop"<<std::endl;
+      return;
+    }
+    n_entries = trkana->GetEntries();
+  }
+  for (unsigned int n_threads = 1; n_threads <= max_threads; n_threads *= 2){
+    std::vector<long> n_selected(n_threads, 0);
+    std::vector<double> n_bytes(n_threads, 0);
+    double seconds = TimeSeconds([&](){
+      std::vector<std::thread> workers;
+      for (unsigned int t = 0; t < n_threads; ++t){
+        workers.emplace_back([&, t](){
+          std::unique_ptr<TFile> file(TFile::Open(filename));
+          TTree *trkana = (TTree*)file->Get("TrkAna/trkana");
+          TrkAnaEvent event;
+          event.SetBranchAddresses(trkana);
+          long selected = 0;
+          double bytes = 0;
+          for (Long64_t i = n_entries*t/n_threads; i < n_entries*(t + 1)/n_threads; ++i){
+            bytes += trkana->GetEntry(i);
+            ForEachCandidate(event, true, [&](const mu2e::TrkFitInfo&){ selected++; });
+          }
+          n_selected[t] = selected;
+          n_bytes[t] = bytes;
+        });
+      }
+      for (auto& worker : workers) worker.join();
+    });
+    long total = 0;
+    double bytes = 0;
+    for (unsigned int t = 0; t < n_threads; ++t){
+      total += n_selected[t];
+      bytes += n_bytes[t];
+    }
+    std::cout<<"ntuple loop: "<<n_threads<<" threads: "<<n_entries/seconds<<" events/s, "<<1e-6*bytes/seconds<<" MB/s unpacked ("<<total<<" selected)"<<std::endl;
+    results.push_back(BenchResult{"ntuple_loop", {{"threads", double(n_threads)}, {"events_per_s", n_entries/seconds},
+                                                  {"mb_per_s", 1e-6*bytes/seconds}, {"n_events", double(n_entries)},
+                                                  {"n_selected", double(total)}}});
+  }
+}
+
+int main(int argc, char* argv[]){
+  std::cout<<"========== Mu2e's Reference Ana benchmarks =========="<<std::endl;
+  TString outname = argc > 1 ? argv[1] : "ReferenceAnaBench.json";
+  unsigned int max_threads = argc > 2 ? atoi(argv[2]) : std::thread::hardware_concurrency();
+  int n_events = argc > 3 ? atoi(argv[3]) : 200000;
+  TString ntuple = argc > 4 ? argv[4] : "";
+  if(max_threads < 1) max_threads = 1;
+  double mom_lo = 95;
+  double mom_hi = 106;
+
+  RooMsgService::instance().setGlobalKillBelow(RooFit::WARNING);
+  std::vector<BenchResult> results;
+  BenchPdfs(results, mom_lo, mom_hi);
+  BenchFit(results, mom_lo, mom_hi, 1000);
+  BenchEventLoop(results, n_events, max_threads);
+  if(ntuple != "") BenchNTupleLoop(results, ntuple, max_threads);
+  WriteResults(outname, results);
+  return 0;
+}
@@ -2,15 +2,25 @@
 Driving function for analysis
 */
 
+#include <algorithm>
+#include <cstdlib>
 #include <fstream>
 #include<iostream>
+#include <map>
+#include <set>
 //#include "ReferenceAna/inc/Mu2eAna.hh"
 #include "ReferenceAna/inc/Likelihood.hh"
-
-#include "TrkAna/inc/CrvHitInfoReco.hh"
-#include "TrkAna/inc/MVAResultInfo.hh"
-#include "TrkAna/inc/TrkInfo.hh"
-#include "TrkAna/inc/SimInfo.hh"
+#include "ReferenceAna/inc/EventSelection.hh"
+#include "ReferenceAna/inc/RunReport.hh"
+#include "ReferenceAna/inc/BatchConfig.hh"
+#include "ReferenceAna/inc/SystematicUniverses.hh"
+#include "ReferenceAna/inc/TemplateMorphing.hh"
+#include "ReferenceAna/inc/OnlineFit.hh"
+#include "ReferenceAna/inc/Bootstrap.hh"
+#include "ReferenceAna/inc/TruthCounts.hh"
+#include "ReferenceAna/inc/Campaign.hh"
+#include "ReferenceAna/inc/Checkpoint.hh"
+#include <thread>
 
 using namespace std;
 using namespace rootfitter;
@@ -19,6 +29,7 @@ TString Fpath = "/exp/mu2e/app/users/sophie/ProductionEnsembles_v2/py-ana/trkana
 
 
 TTree *ImportNTuple(TString filename){
+  ScopedStage stage("ImportNTuple");
   TFile *f = TFile::Open(Fpath+filename);
   TTree *trkana = (TTree*)f->Get("TrkAna/trkana");  
   return trkana;
@@ -34,184 +45,417 @@ TH1F *GetRecoHist(TTree* trkana, bool usecuts, double mom_lo, double mom_hi){
   return hist_mom1;
 }
 
-TTree* make_CRV_cuts_tree(TTree *trkana, bool usecuts, double mom_low, double mom_hi, std::tuple <double, double, double, double>& mcresults){
-    std::vector<std::vector<mu2e::TrkFitInfo> >* tracks = 0;
-    trkana->SetBranchAddress("demfit", &tracks);
-
-    std::vector<mu2e::CrvHitInfoReco>* crvcoincs = 0;
-    trkana->SetBranchAddress("crvcoincs", &crvcoincs);
-    
-    mu2e::MVAResultInfo* trkquals = 0;
-    trkana->SetBranchAddress("demtrkqual", &trkquals);
-    
-    std::vector<std::vector<mu2e::LoopHelixInfo>>* lhs = 0;
-    trkana->SetBranchAddress("demlh", &lhs);
-    
-    std::vector<std::vector<mu2e::SimInfo>>* sims = 0;
-    trkana->SetBranchAddress("demmcsim", &sims);
-    
+// fitted: FitObservable bits whose hard cut is left to the fit (the tree always has t0 and trkqual)
+// truth is filled in the same pass: one classification per event, counts at each cut stage
+// checkpoint, if given, resumes the loop from its last save and saves it periodically
+TTree* make_CRV_cuts_tree(TTree *trkana, bool usecuts, TruthCounts &truth, int fitted = 0, LoopCheckpoint *checkpoint = 0){
+    ScopedStage stage("Selection");
+    TrkAnaEvent event;
+    event.SetBranchAddresses(trkana);
     
     Float_t recomom;
+    Float_t t0;
+    Float_t trkqual;
     TTree *tree_recomom = new TTree("recomom","recomom");
     tree_recomom->Branch("recomom", &recomom, "recomom/F"); // reco mom
-    double nCE = 0;
-    double nDIO = 0;
-    double nCosmics = 0;
-    double nRPC = 0;
-    unsigned int n_events = trkana->GetEntries();
-    for (unsigned int i_event = 0; i_event < n_events; ++i_event) {
-      bool passCE = false;
-      bool passDIO = false;
+    tree_recomom->Branch("t0", &t0, "t0/F");
+    tree_recomom->Branch("trkqual", &trkqual, "trkqual/F");
+    Long64_t n_events = trkana->GetEntries();
+    Long64_t first = checkpoint ? checkpoint->Restore(LoopInput(trkana, usecuts, fitted), 0, tree_recomom, &truth) : 0;
+    for (Long64_t i_event = first; i_event < n_events; ++i_event) {
       trkana->GetEntry(i_event);
-      bool passes_lhcuts = false;
-      for (auto& lh : *lhs) { 
-        if(lh.size() > 0){ 
-          if(usecuts and trkquals->result > 0.2 and lh[0].t0> 700 and lh[0].t0err < 0.9 and lh[0].maxr<680){
-            passes_lhcuts = true;
-          } if(!usecuts) passes_lhcuts = true;
-        }
-      }
-      for (auto& track : *tracks) {
-        for (auto& fit : track) {
-          if (fit.sid == 0) {
-            double track_time = fit.time;
-            bool crvhit = false;
-            for (auto& crvcoinc : *crvcoincs) {
-              double crvcoinc_time = crvcoinc.time;
-              if (std::fabs(crvcoinc_time - track_time) < 150) {
-                crvhit = true;
-              }
-            }
-            if (!crvhit and passes_lhcuts) {
-              for (auto& sim : *sims) {
-                for (auto& s : sim){
-                  double startCode = s.startCode;
-                  if(fit.mom.R() > mom_low and startCode == 166 and !passDIO ) { nDIO+=1; passDIO=true;}
-                  if(fit.mom.R() > mom_low and fit.mom.R() < mom_hi and startCode == 167 and !passCE) { nCE +=1;passCE=true;}
-                }
-              }
-              recomom = (fit.mom.R());
-              tree_recomom->Fill();
-            }
-          }
-        }
-      }
-    }
-    mcresults = make_tuple(nCE,nDIO,nCosmics,nRPC);
-    std::cout<<"MC Truth Count = nCE "<<nCE<<" nDIO "<<nDIO<<std::endl;
+      truth.Fill(event, usecuts, [&](const mu2e::TrkFitInfo& fit){
+        recomom = (fit.mom.R());
+        t0 = EventT0(event);
+        trkqual = event.trkquals->result;
+        tree_recomom->Fill();
+      }, fitted);
+      if(checkpoint) checkpoint->Update(i_event + 1, 0, tree_recomom, &truth);
+    }
+    if(checkpoint and first < n_events) checkpoint->Save(n_events, 0, tree_recomom, &truth);
+    stage.AddEntries(n_events - first);
+    std::cout<<"MC Truth Count = nCE "<<truth.Selected(kOriginCE)<<" nDIO "<<truth.Selected(kOriginDIO)<<std::endl;
     return tree_recomom;
 }
     
 void PlotMC(){} // TODO - plot the momentum of the true CE's - where are they?
 
-TH1F* make_CRV_cuts(TTree *trkana, bool usecuts, double mom_low, double mom_hi, std::tuple <double, double, double, double>& mcresults){
-    std::vector<std::vector<mu2e::TrkFitInfo> >* tracks = 0;
-    trkana->SetBranchAddress("demfit", &tracks);
-
-    std::vector<mu2e::CrvHitInfoReco>* crvcoincs = 0;
-    trkana->SetBranchAddress("crvcoincs", &crvcoincs);
-    
-    mu2e::MVAResultInfo* trkquals = 0;
-    trkana->SetBranchAddress("demtrkqual", &trkquals);
-    
-    std::vector<std::vector<mu2e::LoopHelixInfo>>* lhs;
-    trkana->SetBranchAddress("demlh", &lhs);
-    
-    std::vector<std::vector<mu2e::SimInfo>>* sims;
-    trkana->SetBranchAddress("demmcsim", &sims);
+TH1F* make_CRV_cuts(TTree *trkana, bool usecuts, double mom_low, TruthCounts &truth, LoopCheckpoint *checkpoint = 0){
+    ScopedStage stage("Selection");
+    TrkAnaEvent event;
+    event.SetBranchAddresses(trkana);
     
     TH1F* hist_mom1 = new TH1F("hist_mom1","",100, mom_low, 110);
-    double nCE = 0;
-    double nDIO = 0;
-    double nCosmics = 0;
-    double nRPC = 0;
-    
-    unsigned int n_events = trkana->GetEntries();
-    for (unsigned int i_event = 0; i_event < n_events; ++i_event) {
-      bool passCE = false;
-      bool passDIO = false;
-      
+    Long64_t n_events = trkana->GetEntries();
+    Long64_t first = checkpoint ? checkpoint->Restore(LoopInput(trkana, usecuts, 0), hist_mom1, 0, &truth) : 0;
+    for (Long64_t i_event = first; i_event < n_events; ++i_event) {
       trkana->GetEntry(i_event);
-      bool passes_lhcuts = false;
-      for (auto& lh : *lhs) { 
-        if(lh.size() > 0){ 
-          if(usecuts and trkquals->result > 0.2 and lh[0].t0> 700 and lh[0].t0err < 0.9 and lh[0].maxr<680){
-            passes_lhcuts = true;
-          } if(!usecuts) passes_lhcuts = true;
-        }
-      }
-      for (auto& track : *tracks) {
-        for (auto& fit : track) {
-          if (fit.sid == 0) {
-            double track_time = fit.time;
-            bool crvhit = false;
-            for (auto& crvcoinc : *crvcoincs) {
-              double crvcoinc_time = crvcoinc.time;
-              if (std::fabs(crvcoinc_time - track_time) < 150) { //TODO optimize!!!!
-                crvhit = true;
-              }
-            }
-            if (!crvhit and passes_lhcuts) {
-              for (auto& sim : *sims) {
-                for (auto& s : sim){
-                  double startCode = s.startCode;
-                  if(fit.mom.R() > mom_low and startCode == 166 and !passDIO ) { nDIO+=1; passDIO=true;}
-                  if(fit.mom.R() > mom_low and fit.mom.R() < mom_hi and startCode == 167 and !passCE) { nCE +=1;passCE=true;}
-                }
-              }
-              hist_mom1->Fill(fit.mom.R());
-              
-            }
-          }
-        }
-      }
-    }
-    mcresults = make_tuple(nCE,nDIO,nCosmics,nRPC);
-    std::cout<<"MC Truth Count: nCE "<<nCE<<" nDIO "<<nDIO<<std::endl;
+      truth.Fill(event, usecuts, [&](const mu2e::TrkFitInfo& fit){
+        hist_mom1->Fill(fit.mom.R());
+      });
+      if(checkpoint) checkpoint->Update(i_event + 1, hist_mom1, 0, &truth);
+    }
+    if(checkpoint and first < n_events) checkpoint->Save(n_events, hist_mom1, 0, &truth);
+    stage.AddEntries(n_events - first);
+    std::cout<<"MC Truth Count: nCE "<<truth.Selected(kOriginCE)<<" nDIO "<<truth.Selected(kOriginDIO)<<std::endl;
     return hist_mom1;
 }
 
-void RunBinnedFit(TH1F* histmom, TString Run, bool cuts, double mom_lo, double mom_hi, std::tuple <double, double, double, double> &fitresult){
+RooFitResult *RunBinnedFit(Likelihood &lh, TH1F* histmom, TString Run, bool cuts, double mom_lo, double mom_hi, FitRecord &record){
   std::cout<<" ------  calling root-fitter with binned fit -----  "<<std::endl;
-  Likelihood *lh = new Likelihood();
-  RooFitResult *result = lh->CalculateBinnedLikelihood(histmom, Run, cuts, mom_lo, mom_hi, fitresult);
+  RooFitResult *result = lh.CalculateBinnedLikelihood(histmom, Run, cuts, mom_lo, mom_hi, record);
   result->Print();
+  return result;
 }
 
-void RunUnbinnedFit(TTree* mom, TString Run, bool cuts, double mom_lo, double mom_hi, std::tuple <double, double, double, double> &fitresult){
+RooFitResult *RunUnbinnedFit(Likelihood &lh, TTree* mom, TString Run, bool cuts, double mom_lo, double mom_hi, FitRecord &record){
   std::cout<<" ------  calling root-fitter with unbinned fit ----- "<<std::endl;
-  Likelihood *lh = new Likelihood();
-  RooFitResult *result = lh->CalculateUnbinnedLikelihood(mom, Run, cuts, mom_lo, mom_hi, fitresult);
+  RooFitResult *result = lh.CalculateUnbinnedLikelihood(mom, Run, cuts, mom_lo, mom_hi, record);
+  result->Print();
+  return result;
+}
+
+RooFitResult *RunMorphedFit(Likelihood &lh, TTree* mom, const MomentumTemplates &templates, TString Run, bool cuts, double mom_lo, double mom_hi, FitRecord &record){
+  std::cout<<" ------  calling root-fitter with unbinned fit, "<<templates.systematics.size()<<" morphed systematics ----- "<<std::endl;
+  RooFitResult *result = lh.CalculateMorphedLikelihood(mom, templates, Run, cuts, mom_lo, mom_hi, record);
+  result->Print();
+  return result;
+}
+
+RooFitResult *RunMultiObservableFit(Likelihood &lh, TTree* mom, int fitted, TString Run, bool cuts, double mom_lo, double mom_hi, FitRecord &record){
+  std::cout<<" ------  calling root-fitter with unbinned fit in momentum"<<((fitted & kFitT0) ? " x t0" : "")<<((fitted & kFitTrkQual) ? " x trkqual" : "")<<" ----- "<<std::endl;
+  RooFitResult *result = lh.CalculateMultiObservableLikelihood(mom, fitted, Run, cuts, mom_lo, mom_hi, record);
   result->Print();
+  return result;
+}
+
+// templates are built (or read) once per input and kept for every later job that uses them
+const MomentumTemplates &GetTemplates(TTree *trkana, const FitJob &job){
+  static std::map<TString, MomentumTemplates> cache;
+  TString key = job.templates;
+  if(key == "") key = Form("%s|%d|%.17g|%.17g|%d", job.filename.Data(), int(job.usecuts), job.mom_lo, job.mom_hi, job.template_bins);
+  auto it = cache.find(key);
+  if(it == cache.end()){
+    if(job.templates != "") it = cache.emplace(key, ReadMomentumTemplates(job.templates)).first;
+    else it = cache.emplace(key, BuildMomentumTemplates(trkana, job.usecuts, job.mom_lo, job.mom_hi, job.template_bins, DefaultUniverses())).first;
+  }
+  return it->second;
+}
+
+// store, if given, receives the extra rows of a job (e.g. one per systematic universe or bootstrap replica)
+// the MC truth histograms go to the store, or to TruthEfficiency.root without one
+void WriteTruth(const TruthCounts &truth, TString name, FitResultStore *store){
+  std::vector<std::unique_ptr<TH1> > hists = truth.Histograms();
+  if(store){
+    name.ReplaceAll("/", "_");
+    for (auto const& hist : hists) store->WriteObject(*hist, "truth/" + name);
+    return;
+  }
+  TFile out("TruthEfficiency.root", "RECREATE");
+  for (auto const& hist : hists) out.WriteTObject(hist.get());
+}
+
+// checkpoint, if given, is used by the job's selection loop
+RooFitResult *RunJob(Likelihood &lh, TTree *trkana, const FitJob &job, FitRecord &record, FitResultStore *store = 0, LoopCheckpoint *checkpoint = 0){
+  TruthCounts truth(job.mom_lo, job.mom_hi);
+  RooFitResult *result = 0;
+  record.name = job.name;
+  record.config_hash = job.ConfigHash();
+  if(job.type == "binned"){
+    TH1F *histmom = make_CRV_cuts(trkana, job.usecuts, job.mom_lo, truth, checkpoint);
+    result = RunBinnedFit(lh, histmom, job.runname, job.usecuts, job.mom_lo, job.mom_hi, record);
+    delete histmom;
+  } else if (job.type == "unbinned") {
+    TTree *mom = make_CRV_cuts_tree(trkana, job.usecuts, truth, 0, checkpoint);
+    result = RunUnbinnedFit(lh, mom, job.runname, job.usecuts, job.mom_lo, job.mom_hi, record);
+    GofResult gof = lh.GoodnessOfFit(mom, job.mom_lo, job.mom_hi, job.gof_toys, job.seed, job.threads);
+    record.ks = gof.ks;
+    record.ad = gof.ad;
+    record.ks_pvalue = gof.ks_pvalue;
+    record.ad_pvalue = gof.ad_pvalue;
+    delete mom;
+  } else if (job.type == "systematics") {
+    SystematicsResult syst = RunSystematics(trkana, job.usecuts, job.mom_lo, job.mom_hi, DefaultUniverses(), job.threads, &truth, checkpoint);
+    record = syst.cv;
+    record.name = job.name;
+    record.config_hash = job.ConfigHash();
+    for (auto universe : syst.universes){
+      universe.name = job.name + "/" + universe.name;
+      universe.config_hash = record.config_hash;
+      if(store) store->Append(universe);
+    }
+  } else if (job.type == "morph") {
+    const MomentumTemplates &templates = GetTemplates(trkana, job);
+    TTree *mom = make_CRV_cuts_tree(trkana, job.usecuts, truth, 0, checkpoint);
+    result = RunMorphedFit(lh, mom, templates, job.runname, job.usecuts, job.mom_lo, job.mom_hi, record);
+    delete mom;
+  } else if (job.type == "multi") {
+    TTree *mom = make_CRV_cuts_tree(trkana, job.usecuts, truth, job.observables, checkpoint);
+    result = RunMultiObservableFit(lh, mom, job.observables, job.runname, job.usecuts, job.mom_lo, job.mom_hi, record);
+    delete mom;
+  } else if (job.type == "bootstrap") {
+    BootstrapResult boot = RunBootstrap(trkana, job.usecuts, job.mom_lo, job.mom_hi, job.replicas, job.seed, job.threads, &truth, checkpoint);
+    record = boot.nominal;
+    record.name = job.name;
+    record.config_hash = job.ConfigHash();
+    for (auto replica : boot.replicas){
+      replica.name = job.name + "/" + replica.name;
+      replica.config_hash = record.config_hash;
+      if(store) store->Append(replica);
+    }
+  } else {
+    std::cout<<"incorrect fit type, please select binned, unbinned, systematics, morph, multi or bootstrap"<<std::endl;
+  }
+  truth.FillRecord(record);
+  truth.Print();
+  WriteTruth(truth, job.name, store);
+  std::cout<<"Fit results NSig = "<<record.nsig<<" NDIO = "<<record.ndio<<" NCOSMIC = "<<record.ncosmics<<" NRPC = 0"<<std::endl;
+  std::cout<<"MC results NSig "<<record.mc_nce<<" NDIO = "<<record.mc_ndio<<" NCOSMIC = 0 NRPC = 0"<<std::endl;
+  return result;
+}
+
+// runs every job of a batch config in this process, sharing opened files and the Likelihood;
+// returns the number of fits that did not converge (status != 0)
+int RunBatch(TString configname){
+  BatchConfig config = ReadBatchConfig(configname);
+  // with checkpointing, fits already in the store are skipped and selection loops resume from their last save
+  std::set<std::pair<TString, ULong64_t> > done;
+  if(config.checkpoint != "" and !config.per_process){
+    std::vector<FitRecord> stored;
+    FitResultStore::Read(config.output, stored);
+    for (auto const& record : stored) done.insert(std::make_pair(record.name, record.config_hash));
+  }
+  auto checkpoint = [&](TString name, ULong64_t config_hash){
+    name.ReplaceAll("/", "_");
+    TString filename = config.checkpoint == "" ? "" : Form("%s.%s.%016llx.root", config.checkpoint.Data(), name.Data(), config_hash);
+    return std::unique_ptr<LoopCheckpoint>(new LoopCheckpoint(filename, config.checkpoint_interval, config.checkpoint_entries));
+  };
+  FitResultStore store(config.output, config.per_process);
+  Likelihood lh;
+  RunReport& report = RunReport::Instance();
+  std::map<TString, TTree*> ntuples;
+  int n_failed = 0;
+  for (auto const& job : config.jobs){
+    if(done.count(std::make_pair(job.name, job.ConfigHash()))){
+      std::cout<<"----------------Job "<<job.name<<": already in "<<config.output<<", skipped ------------"<<std::endl;
+      continue;
+    }
+    std::cout<<"----------------Job "<<job.name<<": analyzing "<<job.runname<<" ------------"<<std::endl;
+    if(ntuples.count(job.filename) == 0) ntuples[job.filename] = ImportNTuple(job.filename);
+    gROOT->cd(); // keep per-job histograms and trees in memory, not in the input file
+
+    FitRecord record;
+    std::unique_ptr<LoopCheckpoint> job_checkpoint = checkpoint(job.name, job.ConfigHash());
+    lh.SetPlotOutput(job.name, config.plots);
+    RooFitResult *result = RunJob(lh, ntuples[job.filename], job, record, &store, job_checkpoint.get());
+    store.Append(record);
+    report.SetResult(job.name + "_Rmue", record.rmue);
+    report.SetResult(job.name + "_status", record.status);
+    if(record.status != 0){
+      std::cout<<"Job "<<job.name<<": fit status "<<record.status<<std::endl;
+      ++n_failed;
+    }
+    if(job_checkpoint->Enabled()){
+      store.Flush();
+      job_checkpoint->Remove();
+    }
+    delete result;
+  }
+  for (auto const& combined : config.combined){
+    if(done.count(std::make_pair(combined.name, combined.ConfigHash()))){
+      std::cout<<"----------------Combined fit "<<combined.name<<": already in "<<config.output<<", skipped ------------"<<std::endl;
+      continue;
+    }
+    std::cout<<"----------------Combined fit "<<combined.name<<": "<<combined.categories.size()<<" categories ------------"<<std::endl;
+    std::vector<FitCategory> categories;
+    std::vector<std::unique_ptr<TruthCounts> > truths;
+    std::vector<std::unique_ptr<LoopCheckpoint> > checkpoints;
+    for (unsigned int c = 0; c < combined.categories.size(); ++c){
+      const FitJob &job = combined.categories[c];
+      if(ntuples.count(job.filename) == 0) ntuples[job.filename] = ImportNTuple(job.filename);
+      gROOT->cd();
+      FitCategory category;
+      category.name = job.name;
+      category.captures = job.captures;
+      truths.emplace_back(new TruthCounts(job.mom_lo, job.mom_hi));
+      checkpoints.push_back(checkpoint(combined.name + "_" + job.name, job.ConfigHash()));
+      category.mom = make_CRV_cuts_tree(ntuples[job.filename], job.usecuts, *truths.back(), 0, checkpoints.back().get());
+      categories.push_back(category);
+    }
+    std::vector<FitRecord> records;
+    RooFitResult *result = lh.CalculateSimultaneousLikelihood(categories, combined.categories[0].mom_lo, combined.categories[0].mom_hi, combined.threads, records);
+    result->Print();
+    records[0].name = combined.name;
+    records[0].config_hash = combined.ConfigHash();
+    for (unsigned int c = 0; c < categories.size(); ++c){
+      FitRecord &record = records[c + 1];
+      record.name = combined.name + "/" + record.name;
+      record.config_hash = records[0].config_hash;
+      truths[c]->FillRecord(record);
+      WriteTruth(*truths[c], record.name, &store);
+      records[0].mc_nce += record.mc_nce;
+      records[0].mc_ndio += record.mc_ndio;
+      for (int i = 0; i < kNOrigins*2; ++i) records[0].confusion[i] += record.confusion[i];
+      for (int i = 0; i < kNOrigins*kNStages; ++i) records[0].cutflow[i] += record.cutflow[i];
+      delete categories[c].mom;
+    }
+    for (auto const& record : records) store.Append(record);
+    report.SetResult(combined.name + "_Rmue", records[0].rmue);
+    report.SetResult(combined.name + "_status", records[0].status);
+    if(records[0].status != 0){
+      std::cout<<"Combined fit "<<combined.name<<": fit status "<<records[0].status<<std::endl;
+      ++n_failed;
+    }
+    if(config.checkpoint != ""){
+      store.Flush();
+      for (auto& category_checkpoint : checkpoints) category_checkpoint->Remove();
+    }
+    delete result;
+  }
+  store.Close();
+  std::cout<<"Batch results for "<<config.jobs.size()<<" jobs and "<<config.combined.size()<<" combined fits written to "<<store.GetFilename()<<std::endl;
+  if(n_failed > 0) std::cout<<n_failed<<" fits did not converge"<<std::endl;
+  report.SetResult("n_failed", n_failed);
+  return n_failed;
+}
+
+// watches directory for new .tka files and publishes a refit to the store after every batch of them;
+// stops after max_idle polls without new files (0: never)
+int RunOnline(TString directory, TString runname, bool usecuts, int poll_s, TString output, int max_idle){
+  FitJob job;
+  job.filename = directory;
+  job.runname = runname;
+  job.usecuts = usecuts;
+  job.type = "online";
+  OnlineFit online(directory, usecuts, job.mom_lo, job.mom_hi);
+  FitResultStore store(output);
+  int n_updates = 0;
+  int n_idle = 0;
+  std::cout<<"----------------Online: watching "<<directory<<" every "<<poll_s<<" s ------------"<<std::endl;
+  while(max_idle == 0 or n_idle < max_idle){
+    std::vector<TString> files = online.NewFiles();
+    if(files.empty()){
+      ++n_idle;
+      gSystem->Sleep(1000*poll_s);
+      continue;
+    }
+    n_idle = 0;
+    for (auto const& file : files) online.AddFile(file);
+    FitRecord record;
+    record.name = Form("%s/update%d", runname.Data(), n_updates++);
+    record.config_hash = job.ConfigHash();
+    online.Update(record);
+    store.Append(record);
+    store.Flush();
+    std::cout<<"Online update "<<n_updates<<" ("<<online.NFiles()<<" files, "<<online.Data().numEntries()<<" candidates): NSig = "<<record.nsig
+             <<" NDIO = "<<record.ndio<<" NCOSMIC = "<<record.ncosmics<<" Rmue = "<<record.rmue<<" fit "<<record.fit_wall_s<<" s"<<std::endl;
+  }
+  store.Close();
+  std::cout<<n_updates<<" online updates written to "<<store.GetFilename()<<std::endl;
+  return 0;
+}
+
+void Usage(){
+  std::cout<<"usage: ReferenceAna <file> <run> <usecuts: true|false> <binned|unbinned|systematics|morph|multi|bootstrap> [report.json] [results.root]"<<std::endl;
+  std::cout<<"       ReferenceAna --batch <jobs.fcl> [report.json]"<<std::endl;
+  std::cout<<"       ReferenceAna --merge <output.root> <shard.root> [shard.root ...]"<<std::endl;
+  std::cout<<"       ReferenceAna --campaign <campaign.fcl>"<<std::endl;
+  std::cout<<"       ReferenceAna --online <directory> <run> <usecuts: true|false> [poll seconds=60] [output.root] [max idle polls=0]"<<std::endl;
 }
 
 int main(int argc, char* argv[]){
   std::cout<<"========== Welcome to Mu2e's Reference Ana =========="<<std::endl;
+  if(argc > 2 and TString(argv[1]) == "--batch"){
+    if(argc > 3) RunReport::Instance().Enable(argv[3]); // JSON run report
+    int ret = 0;
+    try {
+      ret = RunBatch(argv[2]);
+    } catch (std::exception &e) {
+      std::cout<<"batch mode failed: "<<e.what()<<std::endl;
+      return 1;
+    }
+    RunReport::Instance().Write();
+    return ret > 0 ? 1 : 0; // exit codes wrap at 256
+  }
+  if(argc > 3 and TString(argv[1]) == "--merge"){
+    std::vector<TString> shards(argv + 3, argv + argc);
+    bool ok = FitResultStore::Merge(shards, argv[2]);
+    std::cout<<(ok ? "Merged " : "Failed to merge ")<<shards.size()<<" result shards into "<<argv[2]<<std::endl;
+    return ok ? 0 : 1;
+  }
+  if(argc > 2 and TString(argv[1]) == "--campaign"){
+    try {
+      return RunCampaign(argv[2], argv[0]);
+    } catch (std::exception &e) {
+      std::cout<<"campaign failed: "<<e.what()<<std::endl;
+      return 1;
+    }
+  }
+  if(argc > 3 and TString(argv[1]) == "--campaign-shard"){ // one worker process of a campaign
+    try {
+      return RunCampaignShard(ReadCampaignConfig(argv[2]), atoi(argv[3]), ImportNTuple);
+    } catch (std::exception &e) {
+      std::cout<<"campaign shard failed: "<<e.what()<<std::endl;
+      return 1;
+    }
+  }
+  if(argc > 4 and TString(argv[1]) == "--online"){
+    bool usecuts = true;
+    if(!ParseBool(argv[4], usecuts)){
+      Usage();
+      return 1;
+    }
+    int poll_s = argc > 5 ? atoi(argv[5]) : 60;
+    TString output = argc > 6 ? argv[6] : "ReferenceAnaOnline.root";
+    int max_idle = argc > 7 ? atoi(argv[7]) : 0;
+    return RunOnline(argv[2], argv[3], usecuts, poll_s, output, max_idle);
+  }
+  if(argc < 5){
+    Usage();
+    return 1;
+  }
   std::cout<<"----------------Analyzing "<<argv[2]<<" ------------"<<std::endl;
 
-  TString filename = argv[1]; // TrkAna NTuple
-  TString runname = argv[2]; // e.g. pass0a
-  bool usecuts = argv[3]; //true or false
-  TString type = argv[4]; //binned or unbinned
-  double mom_lo = 95; 
-  double mom_hi = 106;
-  
-  std::tuple <double, double, double, double> mcresult;
-  std::tuple <double, double, double, double> fitresult;
-  
-  TTree *trkana = ImportNTuple(filename);
-
-  if(type == "binned"){
-    TH1F *histmom = make_CRV_cuts(trkana, usecuts, mom_lo, mom_hi, mcresult);
-    RunBinnedFit(histmom, runname, usecuts, mom_lo, mom_hi, fitresult);
-  } else if (type == "unbinned") {
-    TTree *mom = make_CRV_cuts_tree(trkana, usecuts, mom_lo, mom_hi, mcresult);
-    RunUnbinnedFit(mom, runname, usecuts, mom_lo, mom_hi, fitresult);
-  } else {
-    std::cout<<"incorrect fit type, please select binned or unbinned"<<std::endl;
+  FitJob job;
+  job.filename = argv[1]; // TrkAna NTuple
+  job.runname = argv[2]; // e.g. pass0a
+  job.type = argv[4]; //binned, unbinned, systematics, morph, multi or bootstrap
+  job.threads = std::max(1u, std::thread::hardware_concurrency()); // worker processes; NumCPU only for large datasets (kMinEntriesPerCpu)
+  if(!ParseBool(argv[3], job.usecuts)){ //true or false
+    std::cout<<"usecuts must be true or false, got "<<argv[3]<<std::endl;
+    Usage();
+    return 1;
   }
+  if(argc > 5) RunReport::Instance().Enable(argv[5]); // JSON run report
+  TString output = argc > 6 ? argv[6] : "ReferenceAnaResults.root"; // results store, one row (plus universes or replicas)
+  job.name = job.runname + "_" + job.type;
   
-  std::cout<<"Fit results NSig = "<<get<0>(fitresult)<<" NDIO = "<<get<1>(fitresult)<<" NCOSMIC = "<<get<2>(fitresult)<<" NRPC = "<<get<3>(fitresult)<<std::endl;
-  std::cout<<"MC results NSig "<<get<0>(mcresult)<<" NDIO = "<<get<1>(mcresult)<<" NCOSMIC = "<<get<2>(mcresult)<<" NRPC = "<<get<3>(mcresult)<<std::endl;
+  TTree *trkana = ImportNTuple(job.filename);
+  Likelihood lh;
+  FitRecord record;
+  FitResultStore store(output);
+  RooFitResult *result = RunJob(lh, trkana, job, record, &store);
+  store.Append(record);
+  store.Close();
+  std::cout<<"Fit result written to "<<store.GetFilename()<<std::endl;
+  delete result;
+
+  RunReport& report = RunReport::Instance();
+  report.SetResult("nsig", record.nsig);
+  report.SetResult("ndio", record.ndio);
+  report.SetResult("ncosmics", record.ncosmics);
+  report.SetResult("mc_nce", record.mc_nce);
+  report.SetResult("mc_ndio", record.mc_ndio);
+  if(job.type == "unbinned"){
+    report.SetResult("ks", record.ks);
+    report.SetResult("ad", record.ad);
+    report.SetResult("ks_pvalue", record.ks_pvalue);
+    report.SetResult("ad_pvalue", record.ad_pvalue);
+  }
+  for (int o = 0; o < kNOrigins; ++o){
+    report.SetResult(Form("truth_%s_rejected", TruthCounts::OriginName(o)), record.confusion[2*o]);
+    report.SetResult(Form("truth_%s_selected", TruthCounts::OriginName(o)), record.confusion[2*o + 1]);
+  }
+  report.Write();
   return 0;
 }
@@ -0,0 +1,105 @@
+#include "ReferenceAna/inc/RunReport.hh"
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sys/resource.h>
+#include "TFile.h"
+#include "TROOT.h"
+using namespace rootfitter;
+
+double rootfitter::WallSeconds(){
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double rootfitter::CpuSeconds(){
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + 1e-6*(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+long rootfitter::PeakRSSkB(){
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss; // kB on Linux
+}
+
+RunReport& RunReport::Instance(){
+  static RunReport report;
+  return report;
+}
+
+StageRecord& RunReport::Stage(const TString& name){
+  for (auto& stage : fStages){
+    if(stage.name == name) return stage;
+  }
+  fStages.emplace_back();
+  fStages.back().name = name;
+  return fStages.back();
+}
+
+void RunReport::SetResult(const TString& name, double value){
+  if(!fEnabled) return;
+  for (auto& result : fResults){
+    if(result.first == name) { result.second = value; return; }
+  }
+  fResults.emplace_back(name, value);
+}
+
+// quoted JSON string: quotes, backslashes and control characters escaped
+static TString JsonString(const TString& value){
+  TString quoted = "\"";
+  for (int i = 0; i < value.Length(); ++i){
+    char c = value[i];
+    if(c == '"' or c == '\\') { quoted += '\\'; quoted += c; }
+    else if((unsigned char)c < 0x20) quoted += Form("\\u%04x", (unsigned char)c);
+    else quoted += c;
+  }
+  return quoted + "\"";
+}
+
+// JSON has no nan or inf
+static TString JsonNumber(double value){
+  if(!std::isfinite(value)) return "null";
+  return Form("%.10g", value);
+}
+
+void RunReport::Write() const {
+  if(!fEnabled) return;
+  std::ofstream out(fFilename.Data());
+  out<<"{\n  \"root_version\": \""<<gROOT->GetVersion()<<"\",\n";
+  out<<"  \"peak_rss_kb\": "<<PeakRSSkB()<<",\n";
+  out<<"  \"stages\": [\n";
+  for (unsigned int i = 0; i < fStages.size(); ++i){
+    const StageRecord& s = fStages[i];
+    out<<"    {\"name\": "<<JsonString(s.name)<<", \"calls\": "<<s.ncalls<<", \"wall_s\": "<<JsonNumber(s.wall_s)<<", \"cpu_s\": "<<JsonNumber(s.cpu_s)
+       <<", \"peak_rss_kb\": "<<s.peak_rss_kb<<", \"bytes_read\": "<<s.bytes_read<<", \"entries\": "<<s.entries
+       <<", \"nll_calls\": "<<s.nll_calls<<", \"minimizer_iterations\": "<<s.minimizer_iterations<<"}"
+       <<(i + 1 < fStages.size() ? "," : "")<<"\n";
+  }
+  out<<"  ],\n  \"results\": {";
+  for (unsigned int i = 0; i < fResults.size(); ++i){
+    out<<(i ? ", " : "")<<JsonString(fResults[i].first)<<": "<<JsonNumber(fResults[i].second);
+  }
+  out<<"}\n}\n";
+  std::cout<<"Run report written to "<<fFilename<<std::endl;
+}
+
+ScopedStage::ScopedStage(const char* name){
+  RunReport& report = RunReport::Instance();
+  if(!report.IsEnabled()) return;
+  fRecord = &report.Stage(name);
+  fRecord->ncalls++;
+  fWall0 = WallSeconds();
+  fCpu0 = CpuSeconds();
+  fBytes0 = TFile::GetFileBytesRead();
+}
+
+void ScopedStage::Stop(){
+  if(!fRecord) return;
+  fRecord->wall_s += WallSeconds() - fWall0;
+  fRecord->cpu_s += CpuSeconds() - fCpu0;
+  fRecord->bytes_read += TFile::GetFileBytesRead() - fBytes0;
+  fRecord->peak_rss_kb = PeakRSSkB();
+  fRecord = 0;
+}
@@ -0,0 +1,180 @@
+#include "ReferenceAna/inc/SystematicUniverses.hh"
+#include "ReferenceAna/inc/EventSelection.hh"
+#include "ReferenceAna/inc/TruthCounts.hh"
+#include "ReferenceAna/inc/Checkpoint.hh"
+#include "ReferenceAna/inc/FitModel.hh"
+#include "ReferenceAna/inc/RunReport.hh"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include "TTree.h"
+#include "RooDataSet.h"
+using namespace rootfitter;
+
+std::vector<SystUniverse> rootfitter::DefaultUniverses(){
+  std::vector<SystUniverse> universes;
+  for (double nsigma : {-1., 1.}){
+    SystUniverse scale;
+    scale.band = "MomScale";
+    scale.nsigma = nsigma;
+    scale.mom_scale = 1 + nsigma*1e-3;
+    universes.push_back(scale);
+  }
+  for (double nsigma : {-1., 1.}){
+    SystUniverse shift;
+    shift.band = "MomShift";
+    shift.nsigma = nsigma;
+    shift.mom_shift = nsigma*0.05; // MeV/c
+    universes.push_back(shift);
+  }
+  for (double nsigma : {-1., 1.}){
+    SystUniverse dio;
+    dio.band = "DIONorm";
+    dio.nsigma = nsigma;
+    dio.weight_per_sigma = 0.1;
+    dio.weight_start_code = 166;
+    universes.push_back(dio);
+  }
+  return universes;
+}
+
+// half the +-1 sigma difference for two-sided bands, the spread of the universes otherwise
+static void BandShifts(const std::vector<const FitRecord*> &records, const std::vector<double> &nsigmas,
+                       std::vector<double> &cov, double &rmue_shift){
+  cov.assign(9, 0);
+  rmue_shift = 0;
+  unsigned int n = records.size();
+  if(n == 0) return;
+  auto yields = [](const FitRecord *r){ return std::vector<double>{r->nsig, r->ndio, r->ncosmics}; };
+  if(n == 2 and nsigmas[0]*nsigmas[1] < 0){
+    int up = nsigmas[0] > 0 ? 0 : 1;
+    std::vector<double> hi = yields(records[up]);
+    std::vector<double> lo = yields(records[1 - up]);
+    for (int i = 0; i < 3; ++i)
+      for (int j = 0; j < 3; ++j) cov[3*i + j] = 0.25*(hi[i] - lo[i])*(hi[j] - lo[j]);
+    rmue_shift = 0.5*(records[up]->rmue - records[1 - up]->rmue);
+    return;
+  }
+  std::vector<double> mean(3, 0);
+  double rmue_mean = 0;
+  for (auto *r : records){
+    std::vector<double> y = yields(r);
+    for (int i = 0; i < 3; ++i) mean[i] += y[i]/n;
+    rmue_mean += r->rmue/n;
+  }
+  for (auto *r : records){
+    std::vector<double> y = yields(r);
+    for (int i = 0; i < 3; ++i)
+      for (int j = 0; j < 3; ++j) cov[3*i + j] += (y[i] - mean[i])*(y[j] - mean[j])/n;
+    rmue_shift += (r->rmue - rmue_mean)*(r->rmue - rmue_mean)/n;
+  }
+  rmue_shift = std::sqrt(rmue_shift);
+}
+
+SystematicsResult rootfitter::RunSystematics(TTree *trkana, bool usecuts, double mom_lo, double mom_hi,
+                                             const std::vector<SystUniverse> &universes, unsigned int n_threads,
+                                             TruthCounts *truth, LoopCheckpoint *checkpoint){
+  std::cout<<" ------  systematic universes: one event pass, "<<universes.size()<<" refits on "<<n_threads<<" processes ----- "<<std::endl;
+  SystematicsResult syst;
+
+  // one pass over the ntuple keeps every candidate's momentum and truth start code, the
+  // state the checkpoint saves
+  Double_t mom;
+  Int_t start_code;
+  TTree candidates("syst_candidates", "selected candidates");
+  candidates.SetDirectory(0);
+  candidates.Branch("mom", &mom, "mom/D");
+  candidates.Branch("start_code", &start_code, "start_code/I");
+  {
+    ScopedStage stage("SystematicsSelection");
+    TrkAnaEvent event;
+    event.SetBranchAddresses(trkana);
+    Long64_t n_events = trkana->GetEntries();
+    Long64_t first = checkpoint ? checkpoint->Restore(LoopInput(trkana, usecuts), 0, &candidates, truth) : 0;
+    for (Long64_t i_event = first; i_event < n_events; ++i_event) {
+      trkana->GetEntry(i_event);
+      auto candidate = [&](const mu2e::TrkFitInfo& fit){
+        mom = fit.mom.R();
+        start_code = PrimaryStartCode(event);
+        candidates.Fill();
+      };
+      if(truth) truth->Fill(event, usecuts, candidate);
+      else ForEachCandidate(event, usecuts, candidate);
+      if(checkpoint) checkpoint->Update(i_event + 1, 0, &candidates, truth);
+    }
+    if(checkpoint and first < n_events) checkpoint->Save(n_events, 0, &candidates, truth);
+    stage.AddEntries(n_events - first);
+  }
+
+  // the CV dataset and every universe's dataset, in candidate order
+  RooRealVar recomom("recomom", "reco mom [MeV/c]", mom_lo, mom_hi);
+  RooRealVar weight("weight", "weight", 1);
+  RooDataSet cvdata("cvdata", "cvdata", RooArgSet(recomom));
+  std::vector<std::unique_ptr<RooDataSet> > data;
+  for (auto const& universe : universes){
+    data.emplace_back(new RooDataSet("data_" + universe.Name(), "", RooArgSet(recomom, weight), RooFit::WeightVar(weight)));
+  }
+  for (Long64_t i = 0; i < candidates.GetEntries(); ++i){
+    candidates.GetEntry(i);
+    if(mom > mom_lo and mom < mom_hi){
+      recomom.setVal(mom);
+      cvdata.add(RooArgSet(recomom));
+    }
+    for (unsigned int u = 0; u < universes.size(); ++u){
+      double umom = universes[u].Momentum(mom);
+      if(umom <= mom_lo or umom >= mom_hi) continue;
+      recomom.setVal(umom);
+      data[u]->add(RooArgSet(recomom), universes[u].Weight(start_code));
+    }
+  }
+
+  // CV fit, then every universe starting from the CV result
+  ScopedStage stage("SystematicsFits");
+  FitModel cvmodel(mom_lo, mom_hi);
+  std::unique_ptr<RooFitResult> cvresult(cvmodel.Fit(cvdata, n_threads));
+  FillFitRecord(*cvresult, syst.cv);
+  syst.cv.name = "CV";
+  syst.cv.rmue = cvmodel.Rmue();
+
+  std::vector<RooAbsData*> universe_data;
+  for (auto& d : data) universe_data.push_back(d.get());
+  FitInParallel(universe_data, &cvresult->floatParsFinal(), mom_lo, mom_hi, n_threads, syst.universes);
+  for (unsigned int u = 0; u < universes.size(); ++u) syst.universes[u].name = universes[u].Name();
+  stage.Stop();
+
+  // per-band shifts and the summed covariance on the yields
+  for (auto const& universe : universes){
+    if(std::find(syst.bands.begin(), syst.bands.end(), universe.band) == syst.bands.end()) syst.bands.push_back(universe.band);
+  }
+  std::cout<<"Systematic universes (shift from CV nsig = "<<syst.cv.nsig<<", Rmue = "<<syst.cv.rmue<<"):"<<std::endl;
+  for (unsigned int u = 0; u < universes.size(); ++u){
+    std::cout<<"  "<<syst.universes[u].name<<": dNSig = "<<syst.universes[u].nsig - syst.cv.nsig
+             <<" dNDIO = "<<syst.universes[u].ndio - syst.cv.ndio<<" dRmue = "<<syst.universes[u].rmue - syst.cv.rmue
+             <<" status "<<syst.universes[u].status<<std::endl;
+  }
+  for (auto const& band : syst.bands){
+    std::vector<const FitRecord*> records;
+    std::vector<double> nsigmas;
+    for (unsigned int u = 0; u < universes.size(); ++u){
+      if(universes[u].band != band) continue;
+      records.push_back(&syst.universes[u]);
+      nsigmas.push_back(universes[u].nsigma);
+    }
+    std::vector<double> cov;
+    double rmue_shift = 0;
+    BandShifts(records, nsigmas, cov, rmue_shift);
+    syst.band_cov.push_back(cov);
+    syst.band_rmue_shift.push_back(rmue_shift);
+    for (int i = 0; i < 9; ++i) syst.cov[i] += cov[i];
+    std::cout<<"  band "<<band<<": sigma(NSig) = "<<std::sqrt(cov[0])<<" sigma(NDIO) = "<<std::sqrt(cov[4])<<" sigma(Rmue) = "<<rmue_shift<<std::endl;
+    RunReport::Instance().SetResult("syst_nsig_" + band, std::sqrt(cov[0]));
+    RunReport::Instance().SetResult("syst_rmue_" + band, rmue_shift);
+  }
+  std::cout<<"Systematic covariance (nsig, ndio, ncosmics):"<<std::endl;
+  for (int i = 0; i < 3; ++i){
+    std::cout<<"  "<<syst.cov[3*i]<<" "<<syst.cov[3*i + 1]<<" "<<syst.cov[3*i + 2]<<std::endl;
+  }
+  RunReport::Instance().SetResult("syst_nsig_total", std::sqrt(syst.cov[0]));
+  return syst;
+}
@@ -0,0 +1,284 @@
+#include "ReferenceAna/inc/TemplateMorphing.hh"
+#include "ReferenceAna/inc/EventSelection.hh"
+#include "ReferenceAna/inc/RunReport.hh"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include "TFile.h"
+#include "TKey.h"
+#include "RooConstVar.h"
+#include "RooFormulaVar.h"
+#include "RooGaussian.h"
+#include "RooHistFunc.h"
+#include "RooRealSumPdf.h"
+#include "RooUniform.h"
+#include "RooStats/HistFactory/PiecewiseInterpolation.h"
+using namespace rootfitter;
+
+// empty template bins would give log(0) in the fit
+static const double kTemplateFloor = 1e-6;
+
+static std::unique_ptr<TH1D> NewTemplate(TString name, int nbins, double mom_lo, double mom_hi){
+  std::unique_ptr<TH1D> hist(new TH1D(name, "", nbins, mom_lo, mom_hi));
+  hist->SetDirectory(0);
+  return hist;
+}
+
+static void ApplyFloor(TH1D &hist){
+  double floor = kTemplateFloor*std::max(hist.Integral(), 1.);
+  for (int bin = 1; bin <= hist.GetNbinsX(); ++bin){
+    if(hist.GetBinContent(bin) < floor) hist.SetBinContent(bin, floor);
+  }
+}
+
+MomentumTemplates rootfitter::BuildMomentumTemplates(TTree *trkana, bool usecuts, double mom_lo, double mom_hi, int nbins,
+                                                     const std::vector<SystUniverse> &universes){
+  ScopedStage stage("BuildTemplates");
+  MomentumTemplates templates;
+  // +-1 sigma universe of each band
+  std::vector<int> up_index, down_index;
+  for (unsigned int u = 0; u < universes.size(); ++u){
+    if(universes[u].nsigma <= 0) continue;
+    for (unsigned int d = 0; d < universes.size(); ++d){
+      if(universes[d].band != universes[u].band or universes[d].nsigma >= 0) continue;
+      templates.systematics.push_back(universes[u].band);
+      up_index.push_back(u);
+      down_index.push_back(d);
+      break;
+    }
+  }
+  const char *names[2] = {"CE", "DIO"};
+  int codes[2] = {167, 166};
+  for (int c = 0; c < 2; ++c){
+    ComponentTemplates component;
+    component.name = names[c];
+    component.start_code = codes[c];
+    component.nominal = NewTemplate(component.name + "_nominal", nbins, mom_lo, mom_hi);
+    for (auto const& syst : templates.systematics){
+      component.up.push_back(NewTemplate(component.name + "_" + syst + "_up", nbins, mom_lo, mom_hi));
+      component.down.push_back(NewTemplate(component.name + "_" + syst + "_down", nbins, mom_lo, mom_hi));
+    }
+    templates.components.push_back(std::move(component));
+  }
+
+  TrkAnaEvent event;
+  event.SetBranchAddresses(trkana);
+  Long64_t n_events = trkana->GetEntries();
+  for (Long64_t i_event = 0; i_event < n_events; ++i_event) {
+    trkana->GetEntry(i_event);
+    int start_code = PrimaryStartCode(event);
+    ComponentTemplates *component = 0;
+    for (auto& c : templates.components){
+      if(c.start_code == start_code) component = &c;
+    }
+    if(!component) continue;
+    ForEachCandidate(event, usecuts, [&](const mu2e::TrkFitInfo& fit){
+      double mom = fit.mom.R();
+      component->nominal->Fill(mom);
+      for (unsigned int s = 0; s < templates.systematics.size(); ++s){
+        const SystUniverse &up = universes[up_index[s]];
+        const SystUniverse &down = universes[down_index[s]];
+        component->up[s]->Fill(up.Momentum(mom), up.Weight(start_code));
+        component->down[s]->Fill(down.Momentum(mom), down.Weight(start_code));
+      }
+    });
+  }
+  stage.AddEntries(n_events);
+
+  for (auto& component : templates.components){
+    std::cout<<"Template "<<component.name<<": "<<component.nominal->GetEntries()<<" entries, "<<templates.systematics.size()<<" systematics"<<std::endl;
+    ApplyFloor(*component.nominal);
+    for (auto& hist : component.up) ApplyFloor(*hist);
+    for (auto& hist : component.down) ApplyFloor(*hist);
+  }
+  return templates;
+}
+
+MomentumTemplates rootfitter::ReadMomentumTemplates(TString filename){
+  std::unique_ptr<TFile> file(TFile::Open(filename));
+  if(!file or file->IsZombie()) throw std::runtime_error(Form("cannot open templates file %s", filename.Data()));
+  std::map<TString, TH1D*> hists;
+  for (auto *key : *file->GetListOfKeys()){
+    TH1D *hist = dynamic_cast<TH1D*>(static_cast<TKey*>(key)->ReadObj());
+    if(!hist) continue;
+    hist->SetDirectory(0);
+    if(hists.count(key->GetName())){ // older cycle
+      delete hist;
+      continue;
+    }
+    hists[key->GetName()] = hist;
+  }
+  auto take = [&](TString name){
+    auto it = hists.find(name);
+    if(it == hists.end()) return std::unique_ptr<TH1D>();
+    std::unique_ptr<TH1D> hist(it->second);
+    hists.erase(it);
+    ApplyFloor(*hist);
+    return hist;
+  };
+
+  MomentumTemplates templates;
+  for (auto const& entry : hists){
+    TString name = entry.first;
+    if(!name.EndsWith("_nominal")) continue;
+    ComponentTemplates component;
+    component.name = name(0, name.Length() - 8);
+    if(component.name == "CE") component.start_code = 167;
+    if(component.name == "DIO") component.start_code = 166;
+    templates.components.push_back(std::move(component));
+  }
+  for (auto const& entry : hists){
+    for (auto const& component : templates.components){
+      TString name = entry.first;
+      if(!name.BeginsWith(component.name + "_") or !name.EndsWith("_up")) continue;
+      TString syst = name(component.name.Length() + 1, name.Length() - component.name.Length() - 4);
+      if(std::find(templates.systematics.begin(), templates.systematics.end(), syst) == templates.systematics.end()) templates.systematics.push_back(syst);
+    }
+  }
+  for (auto& component : templates.components){
+    component.nominal = take(component.name + "_nominal");
+    for (auto const& syst : templates.systematics){
+      std::unique_ptr<TH1D> up = take(component.name + "_" + syst + "_up");
+      std::unique_ptr<TH1D> down = take(component.name + "_" + syst + "_down");
+      if(!up or !down){
+        // a systematic that does not affect this component
+        up.reset(static_cast<TH1D*>(component.nominal->Clone(component.name + "_" + syst + "_up")));
+        down.reset(static_cast<TH1D*>(component.nominal->Clone(component.name + "_" + syst + "_down")));
+        up->SetDirectory(0);
+        down->SetDirectory(0);
+      }
+      component.up.push_back(std::move(up));
+      component.down.push_back(std::move(down));
+    }
+  }
+  for (auto const& entry : hists) delete entry.second;
+  bool ce = false, dio = false;
+  for (auto const& component : templates.components){
+    ce |= component.name == "CE";
+    dio |= component.name == "DIO";
+  }
+  if(!ce or !dio) throw std::runtime_error(Form("templates file %s needs CE_nominal and DIO_nominal", filename.Data()));
+  std::cout<<"Read "<<templates.components.size()<<" components and "<<templates.systematics.size()<<" systematics from "<<filename<<std::endl;
+  return templates;
+}
+
+// up/down over nominal if hist has the nominal shape, 0 otherwise
+static double NormalisationRatio(const TH1D &hist, const TH1D &nominal){
+  double integral = hist.Integral();
+  double nominal_integral = nominal.Integral();
+  if(integral <= 0 or nominal_integral <= 0) return 0;
+  for (int bin = 1; bin <= nominal.GetNbinsX(); ++bin){
+    double expected = nominal.GetBinContent(bin)/nominal_integral;
+    if(std::fabs(hist.GetBinContent(bin)/integral - expected) > 1e-6*expected + 1e-12) return 0;
+  }
+  return integral/nominal_integral;
+}
+
+MorphingModel::MorphingModel(const MomentumTemplates &templates, double mom_lo, double mom_hi) :
+  recomom("recomom", "reco mom [MeV/c]", mom_lo, mom_hi)
+{
+  if(!templates.components.empty()) recomom.setBins(templates.components[0].nominal->GetNbinsX());
+
+  // one nuisance parameter per systematic, constrained to a unit Gaussian; a systematic
+  // that only scales every component morphs no shape and modifies the yields instead
+  RooArgList shape_alphas;
+  std::vector<RooRealVar*> alpha_vars;
+  std::vector<unsigned int> shape_systs, norm_systs;
+  for (unsigned int s = 0; s < templates.systematics.size(); ++s){
+    TString syst = templates.systematics[s];
+    RooRealVar *alpha = new RooRealVar("alpha_" + syst, syst + " nuisance parameter", 0, -5, 5);
+    RooGaussian *constraint = new RooGaussian("constraint_" + syst, syst + " constraint", *alpha, RooFit::RooConst(0), RooFit::RooConst(1));
+    owned.emplace_back(alpha);
+    owned.emplace_back(constraint);
+    alphas.add(*alpha);
+    alpha_vars.push_back(alpha);
+    constraints.add(*constraint);
+    bool normalisation = true;
+    for (auto const& component : templates.components){
+      normalisation &= NormalisationRatio(*component.up[s], *component.nominal) > 0 and NormalisationRatio(*component.down[s], *component.nominal) > 0;
+    }
+    if(normalisation){
+      norm_systs.push_back(s);
+    } else {
+      shape_systs.push_back(s);
+      shape_alphas.add(*alpha);
+    }
+  }
+
+  auto histfunc = [&](const TH1D &hist, TString name) -> RooHistFunc& {
+    hists.emplace_back(new RooDataHist(name + "_hist", name, RooArgList(recomom), &hist));
+    RooHistFunc *func = new RooHistFunc(name, name, RooArgSet(recomom), *hists.back());
+    owned.emplace_back(func);
+    return *func;
+  };
+  RooArgList shapes;
+  for (auto const& component : templates.components){
+    RooArgList lows, highs;
+    for (unsigned int s : shape_systs){
+      lows.add(histfunc(*component.down[s], component.name + "_" + templates.systematics[s] + "_down"));
+      highs.add(histfunc(*component.up[s], component.name + "_" + templates.systematics[s] + "_up"));
+    }
+    RooAbsReal *morph = &histfunc(*component.nominal, component.name + "_nominal");
+    if(!shape_systs.empty()){
+      PiecewiseInterpolation *interpolation = new PiecewiseInterpolation(component.name + "_morph", component.name + " morphed template",
+                                                                         *morph, lows, highs, shape_alphas);
+      interpolation->setPositiveDefinite();
+      interpolation->setAllInterpCodes(4); // polynomial inside |alpha| < 1, linear outside
+      owned.emplace_back(interpolation);
+      morph = interpolation;
+    }
+    RooRealSumPdf *shape = new RooRealSumPdf(component.name, component.name + " shape", RooArgList(*morph), RooArgList(RooFit::RooConst(1)));
+    owned.emplace_back(shape);
+    shapes.add(*shape);
+
+    TString yield = component.name == "CE" ? "nsig" : component.name == "DIO" ? "ndio" : "n" + component.name;
+    double max = component.name == "CE" ? 100 : 100000;
+    RooRealVar *n = new RooRealVar(yield, "number of " + component.name + " events", 0.0, 0.0, max);
+    owned.emplace_back(n);
+    yields.add(*n);
+
+    // normalisation nuisances: n x prod(1 + alpha x (ratio - 1))
+    TString formula = "@0";
+    RooArgList modifiers(*n);
+    for (unsigned int s : norm_systs){
+      double up = NormalisationRatio(*component.up[s], *component.nominal) - 1;
+      double down = 1 - NormalisationRatio(*component.down[s], *component.nominal);
+      if(std::fabs(up) < 1e-9 and std::fabs(down) < 1e-9) continue;
+      modifiers.add(*alpha_vars[s]);
+      int i = modifiers.getSize() - 1;
+      formula += Form("*(1+@%d*((@%d>0)*%.17g+(@%d<=0)*%.17g))", i, i, up, i, down);
+    }
+    if(modifiers.getSize() == 1){
+      coefficients.add(*n);
+    } else {
+      RooFormulaVar *scaled = new RooFormulaVar(yield + "_scaled", "fitted number of " + component.name + " events", formula, modifiers);
+      owned.emplace_back(scaled);
+      coefficients.add(*scaled);
+    }
+  }
+  for (unsigned int s : norm_systs) std::cout<<"Systematic "<<templates.systematics[s]<<": normalisation only, applied to the yields"<<std::endl;
+
+  // cosmics stay flat
+  RooUniform *cosmic = new RooUniform("Cosmic", "cosmic", recomom);
+  RooRealVar *ncosmics = new RooRealVar("ncosmics", "number of cosmics", 0.0, 0.0, 10);
+  owned.emplace_back(cosmic);
+  owned.emplace_back(ncosmics);
+  shapes.add(*cosmic);
+  yields.add(*ncosmics);
+  coefficients.add(*ncosmics);
+
+  fitFun.reset(new RooAddPdf("fitFun", "morphed CE + DIO + Cosmic", shapes, coefficients));
+}
+
+MorphingModel::~MorphingModel(){
+  fitFun.reset();
+  while(!owned.empty()) owned.pop_back();
+}
+
+RooRealVar& MorphingModel::Yield(TString name){
+  RooRealVar *yield = static_cast<RooRealVar*>(yields.find(name));
+  if(!yield) throw std::runtime_error(Form("MorphingModel has no yield %s", name.Data()));
+  return *yield;
+}
@@ -0,0 +1,112 @@
+#include "ReferenceAna/inc/TruthCounts.hh"
+#include <iomanip>
+#include <iostream>
+#include "TH2D.h"
+#include "TVectorD.h"
+using namespace rootfitter;
+
+static const char *kOriginNames[kNOrigins] = {"CE", "DIO", "Other"};
+static const char *kStageNames[kNStages] = {"all", "track", "lhcuts", "crvveto", "window"};
+
+const char *TruthCounts::OriginName(int origin){ return kOriginNames[origin]; }
+const char *TruthCounts::StageName(int stage){ return kStageNames[stage]; }
+
+TruthCounts::TruthCounts(double mom_lo, double mom_hi, int nbins) : mom_lo(mom_lo), mom_hi(mom_hi) {
+  for (int o = 0; o < kNOrigins; ++o){
+    total[o].reset(new TH1D(Form("truth_total_%s", kOriginNames[o]), Form("%s events with a track;leading track mom [MeV/c];events", kOriginNames[o]), nbins, mom_lo, mom_hi));
+    passed[o].reset(new TH1D(Form("truth_passed_%s", kOriginNames[o]), Form("selected %s events;leading track mom [MeV/c];events", kOriginNames[o]), nbins, mom_lo, mom_hi));
+    total[o]->SetDirectory(0);
+    passed[o]->SetDirectory(0);
+  }
+}
+
+void TruthCounts::Add(TruthOrigin origin, int stage, const mu2e::TrkFitInfo *leading){
+  for (int s = 0; s <= stage; ++s) counts[origin][s] += 1;
+  if(!leading) return;
+  double mom = leading->mom.R();
+  total[origin]->Fill(mom);
+  if(stage == kNStages - 1) passed[origin]->Fill(mom);
+}
+
+void TruthCounts::FillRecord(FitRecord &record) const {
+  record.mc_nce = Selected(kOriginCE);
+  record.mc_ndio = Selected(kOriginDIO);
+  for (int o = 0; o < kNOrigins; ++o){
+    record.confusion[2*o] = Rejected(TruthOrigin(o));
+    record.confusion[2*o + 1] = Selected(TruthOrigin(o));
+    for (int s = 0; s < kNStages; ++s) record.cutflow[kNStages*o + s] = counts[o][s];
+  }
+}
+
+void TruthCounts::Print() const {
+  std::cout<<"MC truth cut flow"<<std::endl<<std::setw(8)<<"";
+  for (int s = 0; s < kNStages; ++s) std::cout<<std::setw(10)<<kStageNames[s];
+  std::cout<<std::endl;
+  for (int o = 0; o < kNOrigins; ++o){
+    std::cout<<std::setw(8)<<kOriginNames[o];
+    for (int s = 0; s < kNStages; ++s) std::cout<<std::setw(10)<<counts[o][s];
+    std::cout<<std::endl;
+  }
+  std::cout<<"MC truth confusion matrix"<<std::endl<<std::setw(8)<<""<<std::setw(12)<<"Background"<<std::setw(10)<<"Signal"<<std::endl;
+  for (int o = 0; o < kNOrigins; ++o){
+    std::cout<<std::setw(8)<<kOriginNames[o]<<std::setw(12)<<Rejected(TruthOrigin(o))<<std::setw(10)<<Selected(TruthOrigin(o))<<std::endl;
+  }
+}
+
+std::vector<std::unique_ptr<TH1> > TruthCounts::Histograms() const {
+  std::vector<std::unique_ptr<TH1> > hists;
+  for (int o = 0; o < kNOrigins; ++o){
+    TH1D *eff = static_cast<TH1D*>(passed[o]->Clone(Form("truth_eff_%s", kOriginNames[o])));
+    eff->SetTitle(Form("%s selection efficiency;leading track mom [MeV/c];efficiency", kOriginNames[o]));
+    eff->Divide(passed[o].get(), total[o].get(), 1, 1, "B");
+    hists.emplace_back(static_cast<TH1*>(total[o]->Clone()));
+    hists.emplace_back(static_cast<TH1*>(passed[o]->Clone()));
+    hists.emplace_back(eff);
+  }
+  TH2D *confusion = new TH2D("truth_confusion", "truth origin x selection outcome", kNOrigins, 0, kNOrigins, 2, 0, 2);
+  TH2D *cutflow = new TH2D("truth_cutflow", "truth origin x cut stage", kNOrigins, 0, kNOrigins, kNStages, 0, kNStages);
+  confusion->GetYaxis()->SetBinLabel(1, "Background");
+  confusion->GetYaxis()->SetBinLabel(2, "Signal");
+  for (int o = 0; o < kNOrigins; ++o){
+    confusion->GetXaxis()->SetBinLabel(o + 1, kOriginNames[o]);
+    cutflow->GetXaxis()->SetBinLabel(o + 1, kOriginNames[o]);
+    confusion->SetBinContent(o + 1, 1, Rejected(TruthOrigin(o)));
+    confusion->SetBinContent(o + 1, 2, Selected(TruthOrigin(o)));
+    for (int s = 0; s < kNStages; ++s){
+      cutflow->GetYaxis()->SetBinLabel(s + 1, kStageNames[s]);
+      cutflow->SetBinContent(o + 1, s + 1, counts[o][s]);
+    }
+  }
+  hists.emplace_back(confusion);
+  hists.emplace_back(cutflow);
+  for (auto& hist : hists) hist->SetDirectory(0);
+  return hists;
+}
+
+void TruthCounts::Save(TDirectory *dir) const {
+  TVectorD flat(kNOrigins*kNStages);
+  for (int o = 0; o < kNOrigins; ++o){
+    for (int s = 0; s < kNStages; ++s) flat[kNStages*o + s] = counts[o][s];
+    dir->WriteTObject(total[o].get());
+    dir->WriteTObject(passed[o].get());
+  }
+  dir->WriteTObject(&flat, "truth_counts");
+}
+
+bool TruthCounts::Restore(TDirectory *dir){
+  std::unique_ptr<TVectorD> flat(static_cast<TVectorD*>(dir->Get("truth_counts")));
+  if(!flat or flat->GetNrows() != kNOrigins*kNStages) return false;
+  for (int o = 0; o < kNOrigins; ++o){
+    TH1D *saved_total = static_cast<TH1D*>(dir->Get(total[o]->GetName()));
+    TH1D *saved_passed = static_cast<TH1D*>(dir->Get(passed[o]->GetName()));
+    if(!saved_total or !saved_passed) return false;
+  }
+  for (int o = 0; o < kNOrigins; ++o){
+    for (int s = 0; s < kNStages; ++s) counts[o][s] = (*flat)[kNStages*o + s];
+    total[o]->Reset();
+    total[o]->Add(static_cast<TH1D*>(dir->Get(total[o]->GetName())));
+    passed[o]->Reset();
+    passed[o]->Add(static_cast<TH1D*>(dir->Get(passed[o]->GetName())));
+  }
+  return true;
+}
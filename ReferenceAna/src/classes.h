@@ -1,3 +1,4 @@
 #include "ReferenceAna/inc/RooPol58.hh"
 #include "ReferenceAna/inc/RooDSCB.hh"
 #include "ReferenceAna/inc/Likelihood.hh"
+#include "ReferenceAna/inc/RooCeMLL.hh"